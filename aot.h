@@ -0,0 +1,41 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include "i8080.h"
+
+// the board's ahead-of-time engine. tools/recompile.c turns the rom into C
+// with one case per basic block it finds statically; builds with -DI8080_AOT
+// link the result (make aot) and machineRunBlock tries it before the
+// interpreter. aotRunBlock runs the block at state->pc and the compiled
+// blocks it leads to, until state->cycles reaches budget or control leaves
+// them, and returns the FLOW_ class of the last one with its start in from.
+// FLOW_NONE has the interpreter carry on from state->pc: when nothing was
+// compiled there, or when a store landed in the rom, which sets state->trap,
+// and the compiled code may be stale. blocks are linked by gotos fixed at
+// generation, so dropping the engine (machineForget) unlinks all of them
+
+#define AOT_RETURNS 16
+#define AOT_PCHL_SITES 4
+#define AOT_PCHL_WAYS 8
+
+// what the compiled code learns as it runs, kept by its caller (Machine) so
+// it carries over from one aotRunBlock to the next. zeroed is empty
+typedef struct {
+    uint16_t returns[AOT_RETURNS];  // ring of return site ids, see tools/recompile.c
+    unsigned int depth;             // pushes not yet popped, may pass AOT_RETURNS
+
+    // targets each PCHL has jumped to, by site, with the label of their block
+    uint16_t pchlTargets[AOT_PCHL_SITES][AOT_PCHL_WAYS];
+    void* pchlLabels[AOT_PCHL_SITES][AOT_PCHL_WAYS];
+    uint8_t pchlCount[AOT_PCHL_SITES];  // ways in use
+    uint8_t pchlNext[AOT_PCHL_SITES];   // way the next miss replaces
+} AotCache;
+
+// pushes a return site id; 0 is a return no compiled block is known for
+static inline void aotPush (AotCache* cache, uint16_t id) {
+    cache->returns[cache->depth++ % AOT_RETURNS] = id;
+}
+
+int aotRunBlock (i8080* state, AotCache* cache, uint64_t budget, uint16_t* from);
+
+#endif
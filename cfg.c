@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "opcodes.h"
+#include "cfg.h"
+
+// the static destination of the instruction at pc, CFG_NONE for RET and PCHL
+static int32_t branchTarget (const uint8_t* memory, uint32_t pc, int flow) {
+    switch (flow) {
+        case FLOW_JUMP:
+        case FLOW_JUMP_COND:
+        case FLOW_CALL:
+        case FLOW_CALL_COND:
+            return memory[pc + 1] | (memory[pc + 2] << 8);
+        case FLOW_RST:
+            return memory[pc] & 0x38;
+        default:
+            return CFG_NONE;
+    }
+}
+
+// walks the block at start; false when it runs into limit before it ends
+static bool walkBlock (const uint8_t* memory, uint32_t limit, uint16_t start, CfgBlock* block) {
+    memset(block, 0, sizeof(*block));
+    block->start = start;
+    uint32_t pc = start;
+    while (pc < limit) {
+        const OpcodeInfo* info = &opcodeTable[memory[pc]];
+        if (pc + info->length > limit) {
+            return false;
+        }
+        block->count++;
+        block->cycles += info->cycles;
+        if (info->flow != FLOW_NONE) {
+            block->last = pc;
+            block->end = pc + info->length;
+            block->flow = info->flow;
+            block->target = branchTarget(memory, pc, info->flow);
+            bool falls = info->flow == FLOW_JUMP_COND || info->flow == FLOW_CALL || info->flow == FLOW_CALL_COND ||
+                         info->flow == FLOW_RET_COND || info->flow == FLOW_RST || info->flow == FLOW_HALT;
+            block->next = falls ? (int32_t) block->end : CFG_NONE;
+            return true;
+        }
+        pc += info->length;
+    }
+    return false;
+}
+
+// opcode and operand bytes of every block; the rest stays CFG_DATA
+static void markBytes (Cfg* cfg, const uint8_t* memory) {
+    memset(cfg->map, CFG_DATA, cfg->limit);
+    for (int i = 0; i < cfg->count; i++) {
+        const CfgBlock* block = &cfg->blocks[i];
+        for (uint32_t pc = block->start; pc < block->end; pc += opcodeTable[memory[pc]].length) {
+            cfg->map[pc] = CFG_OPCODE;
+            for (uint32_t k = 1; k < opcodeTable[memory[pc]].length; k++) {
+                cfg->map[pc + k] = CFG_OPERAND;
+            }
+        }
+    }
+}
+
+static int successor (const Cfg* cfg, const CfgBlock* block, int which) {
+    int32_t address = which ? block->next : block->target;
+    return address == CFG_NONE || (uint32_t) address >= cfg->limit ? CFG_NONE : cfg->index[address];
+}
+
+// depth-first from the entries, then from anything left over in address
+// order: an edge to a block still on the walk's stack closes a loop
+static void markLoops (Cfg* cfg) {
+    uint8_t* state = calloc(cfg->count, 1);         // 0 new, 1 on the stack, 2 done
+    int* stack = malloc(cfg->count * sizeof(int));
+    uint8_t* edge = malloc(cfg->count);             // next successor to look at
+    if (!state || !stack || !edge) {
+        free(state);
+        free(stack);
+        free(edge);
+        return;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (int root = 0; root < cfg->count; root++) {
+            if (state[root] || (pass == 0 && !(cfg->blocks[root].flags & CFG_ENTRY))) {
+                continue;
+            }
+            int depth = 0;
+            stack[depth++] = root;
+            state[root] = 1;
+            edge[root] = 0;
+            while (depth) {
+                int b = stack[depth - 1];
+                if (edge[b] == 2) {
+                    state[b] = 2;
+                    depth--;
+                    continue;
+                }
+                int s = successor(cfg, &cfg->blocks[b], edge[b]++);
+                if (s == CFG_NONE) {
+                    continue;
+                }
+                if (state[s] == 1) {
+                    cfg->blocks[s].flags |= CFG_LOOP;
+                    cfg->blocks[b].flags |= CFG_BACK_EDGE;
+                    cfg->loops++;
+                }
+                else if (state[s] == 0) {
+                    state[s] = 1;
+                    edge[s] = 0;
+                    stack[depth++] = s;
+                }
+            }
+        }
+    }
+    free(state);
+    free(stack);
+    free(edge);
+}
+
+// worklist over block starts; blocks that would cross limit are left out,
+// and so is everything only they lead to
+int cfgBuild (Cfg* cfg, const uint8_t* memory, uint32_t limit, const uint16_t* entries, int entryCount) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->limit = limit;
+    cfg->index = malloc(limit * sizeof(int32_t));
+    cfg->map = malloc(limit);
+    uint16_t* work = malloc(limit * sizeof(uint16_t));
+    bool* seen = calloc(limit, sizeof(bool));
+    CfgBlock* found = malloc(limit * sizeof(CfgBlock));
+    if (!cfg->index || !cfg->map || !work || !seen || !found) {
+        fprintf(stderr, "Error: Could not allocate the control flow graph\n");
+        free(work);
+        free(seen);
+        free(found);
+        cfgFree(cfg);
+        return -1;
+    }
+
+    int pending = 0;
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i] < limit && !seen[entries[i]]) {
+            seen[entries[i]] = true;
+            work[pending++] = entries[i];
+        }
+    }
+    while (pending) {
+        CfgBlock block;
+        if (!walkBlock(memory, limit, work[--pending], &block)) {
+            continue;
+        }
+        found[cfg->count++] = block;
+        int32_t successors[2] = { block.target, block.next };
+        for (int i = 0; i < 2; i++) {
+            if (successors[i] != CFG_NONE && (uint32_t) successors[i] < limit && !seen[successors[i]]) {
+                seen[successors[i]] = true;
+                work[pending++] = successors[i];
+            }
+        }
+    }
+
+    // address order, then the index
+    cfg->blocks = malloc((cfg->count ? cfg->count : 1) * sizeof(CfgBlock));
+    int n = 0;
+    for (uint32_t a = 0; a < limit; a++) {
+        cfg->index[a] = CFG_NONE;
+    }
+    for (int i = 0; i < cfg->count; i++) {
+        cfg->index[found[i].start] = 0;
+    }
+    for (uint32_t a = 0; a < limit; a++) {
+        if (cfg->index[a] != CFG_NONE) {
+            cfg->index[a] = n++;
+        }
+    }
+    for (int i = 0; i < cfg->count; i++) {
+        cfg->blocks[cfg->index[found[i].start]] = found[i];
+    }
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i] < limit && cfg->index[entries[i]] != CFG_NONE) {
+            cfg->blocks[cfg->index[entries[i]]].flags |= CFG_ENTRY;
+        }
+    }
+    for (int i = 0; i < cfg->count; i++) {
+        const CfgBlock* block = &cfg->blocks[i];
+        bool calls = block->flow == FLOW_CALL || block->flow == FLOW_CALL_COND || block->flow == FLOW_RST;
+        if (calls && successor(cfg, block, 0) != CFG_NONE) {
+            cfg->blocks[successor(cfg, block, 0)].flags |= CFG_ROUTINE;
+        }
+    }
+    markBytes(cfg, memory);
+    markLoops(cfg);
+    free(work);
+    free(seen);
+    free(found);
+    return 0;
+}
+
+const CfgBlock* cfgBlockAt (const Cfg* cfg, uint32_t address) {
+    if (address >= cfg->limit || cfg->index[address] == CFG_NONE) {
+        return NULL;
+    }
+    return &cfg->blocks[cfg->index[address]];
+}
+
+static const char* flowNames[] = {
+    "none", "jump", "jump?", "call", "call?", "ret", "ret?", "rst", "pchl", "hlt"
+};
+
+// text form, one line per block and per run of code bytes:
+//   block <start> <last> <end> <instructions> <states> <flow> <target|-> <next|-> [flags]
+//   code <first> <last>
+// addresses in hex, flags a comma list of entry, routine, loop and back
+int cfgWrite (const Cfg* cfg, const char* path, const char* source) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+    int instructions = 0;
+    uint32_t codeBytes = 0;
+    for (int i = 0; i < cfg->count; i++) {
+        instructions += cfg->blocks[i].count;
+    }
+    for (uint32_t a = 0; a < cfg->limit; a++) {
+        codeBytes += cfg->map[a] != CFG_DATA;
+    }
+    fprintf(file, "# control flow of %s below %04X: %d blocks, %d instructions, %u code bytes, %d loops\n",
+            source, cfg->limit, cfg->count, instructions, codeBytes, cfg->loops);
+    for (int i = 0; i < cfg->count; i++) {
+        const CfgBlock* block = &cfg->blocks[i];
+        fprintf(file, "block %04X %04X %04X %u %u %s ", block->start, block->last, block->end,
+                block->count, block->cycles, flowNames[block->flow]);
+        fprintf(file, block->target == CFG_NONE ? "- " : "%04X ", block->target);
+        fprintf(file, block->next == CFG_NONE ? "-" : "%04X", block->next);
+        const char* names[4] = { "entry", "routine", "loop", "back" };
+        const char* separator = " ";
+        for (int f = 0; f < 4; f++) {
+            if (block->flags & (1 << f)) {
+                fprintf(file, "%s%s", separator, names[f]);
+                separator = ",";
+            }
+        }
+        fputc('\n', file);
+    }
+    for (uint32_t a = 0; a < cfg->limit;) {
+        if (cfg->map[a] == CFG_DATA) {
+            a++;
+            continue;
+        }
+        uint32_t first = a;
+        while (a < cfg->limit && cfg->map[a] != CFG_DATA) {
+            a++;
+        }
+        fprintf(file, "code %04X %04X\n", first, a - 1);
+    }
+    fclose(file);
+    return 0;
+}
+
+void cfgFree (Cfg* cfg) {
+    free(cfg->blocks);
+    free(cfg->index);
+    free(cfg->map);
+    memset(cfg, 0, sizeof(*cfg));
+}
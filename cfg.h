@@ -0,0 +1,55 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// static control flow of a memory image: the basic blocks reachable from a
+// set of entry points by following jumps, calls, RST targets and the
+// fall-through of conditionals, calls and HLT. a block runs from its start
+// to the first instruction with a FLOW_ class, the same split the
+// interpreter makes at run time, so a block entered half way is a block of
+// its own. RET and PCHL targets are not known statically. every byte below
+// the limit is marked as opcode, operand or data, and a depth-first walk
+// from the entries marks the loops
+
+#define CFG_NONE -1
+
+// CfgBlock flags
+#define CFG_ENTRY 0x01          // one of the entry points
+#define CFG_ROUTINE 0x02        // CALL or RST target
+#define CFG_LOOP 0x04           // loop head: the target of a back edge
+#define CFG_BACK_EDGE 0x08      // a successor is a loop head it is inside of
+
+// Cfg map values
+#define CFG_DATA 0
+#define CFG_OPCODE 1
+#define CFG_OPERAND 2
+
+typedef struct {
+    uint16_t start;
+    uint16_t last;          // address of the instruction that ends it
+    uint32_t end;           // address after that instruction
+    uint16_t count;         // instructions
+    uint8_t flow;           // FLOW_ class of the last instruction
+    uint8_t flags;          // CFG_ENTRY ..
+    uint32_t cycles;        // states of the instructions, taken branches not included
+    int32_t target;         // jump, call or RST destination, CFG_NONE when there is none
+    int32_t next;           // fall-through successor, CFG_NONE when there is none
+} CfgBlock;
+
+typedef struct {
+    uint32_t limit;         // blocks lie wholly below this address
+    int count;
+    CfgBlock* blocks;       // in address order
+    int32_t* index;         // block starting at each address below limit, or CFG_NONE
+    uint8_t* map;           // CFG_DATA, CFG_OPCODE or CFG_OPERAND per address below limit
+    int loops;              // back edges
+} Cfg;
+
+int cfgBuild (Cfg* cfg, const uint8_t* memory, uint32_t limit, const uint16_t* entries, int entryCount);
+const CfgBlock* cfgBlockAt (const Cfg* cfg, uint32_t address);
+int cfgWrite (const Cfg* cfg, const char* path, const char* source);
+void cfgFree (Cfg* cfg);
+
+#endif
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "opcodes.h"
+#include "debugger.h"
+
+#ifndef SIGTRAP
+#define SIGTRAP 5       // not defined by every C runtime; gdb stop replies use it
+#endif
+
+static Debugger* active;
+
+static void debuggerInterrupt (int sig) {
+    (void) sig;
+    if (active) {
+        active->interrupt = 1;
+    }
+    signal(SIGINT, debuggerInterrupt);
+}
+
+Debugger* debuggerCreate (bool stopAtStart) {
+    Debugger* debugger = calloc(1, sizeof(Debugger));
+    if (!debugger) {
+        return NULL;
+    }
+    debugger->stepping = stopAtStart;
+    debugger->steps = 0;
+    active = debugger;
+    signal(SIGINT, debuggerInterrupt);     // Ctrl-C breaks into the prompt
+    return debugger;
+}
+
+void debuggerDestroy (Debugger* debugger) {
+    if (active == debugger) {
+        active = NULL;
+        signal(SIGINT, SIG_DFL);
+    }
+    free(debugger);
+}
+
+// marks every block start whose straight-line run arrives at target.
+// whether x reaches it depends only on x + length(x), so walking down from
+// the target and stopping after three consecutive misses is exact. the walk
+// wraps below 0 as pc does, and goes at most once round memory
+static void markBlockStarts (Debugger* debugger, const uint8_t* memory, uint16_t target) {
+    bool r1 = true, r2 = false, r3 = false;     // reach for x+1, x+2, x+3
+    debugger->blockBreaks[target >> 3] |= 1 << (target & 7);
+    for (int i = 1; i < MEMORY_SIZE; i++) {
+        uint16_t x = (uint16_t)(target - i);
+        const OpcodeInfo* info = &opcodeTable[memory[x]];
+        bool reach = info->flow == FLOW_NONE &&
+                     (info->length == 1 ? r1 : info->length == 2 ? r2 : r3);
+        if (reach) {
+            debugger->blockBreaks[x >> 3] |= 1 << (x & 7);
+        }
+        r3 = r2;
+        r2 = r1;
+        r1 = reach;
+        if (!r1 && !r2 && !r3) {
+            break;
+        }
+    }
+}
+
+// block marks are derived from the code bytes when breakpoints change;
+// code rewritten afterwards is only covered once a breakpoint is set again
+void debuggerSetBreak (Debugger* debugger, const i8080* state, uint16_t address, bool set) {
+    bool present = debuggerBit(debugger->breakpoints, address);
+    if (set == present) {
+        return;
+    }
+    debugger->breakpoints[address >> 3] ^= 1 << (address & 7);
+    debugger->count += set ? 1 : -1;
+
+    memset(debugger->blockBreaks, 0, sizeof(debugger->blockBreaks));
+    for (int a = 0; a < MEMORY_SIZE; a++) {
+        if (debuggerBit(debugger->breakpoints, a)) {
+            markBlockStarts(debugger, state->memory, a);
+        }
+    }
+}
+
+static void debuggerMemoryHook (i8080* state, uint16_t address, uint8_t value, int access) {
+    Debugger* debugger = state->hookContext;
+    const uint8_t* bitmap = access == PAGE_HOOK_WRITE ? debugger->watchWrite : debugger->watchRead;
+    if (debuggerBit(bitmap, address) && !debugger->watchHit) {
+        debugger->watchHit = true;
+        debugger->hitAccess = access;
+        debugger->hitAddress = address;
+        debugger->hitValue = value;
+        debugger->hitOld = state->memory[address];
+        state->trap = true;
+    }
+}
+
+static bool pageWatched (const uint8_t* bitmap, int page) {
+    for (int i = page * 32; i < page * 32 + 32; i++) {
+        if (bitmap[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// access is PAGE_HOOK_READ, PAGE_HOOK_WRITE or both
+void debuggerSetWatch (Debugger* debugger, i8080* state, uint16_t address, int length, int access, bool set) {
+    state->memoryHook = debuggerMemoryHook;
+    state->hookContext = debugger;
+    for (int i = 0; i < length; i++) {
+        uint16_t a = address + i;
+        uint8_t bit = 1 << (a & 7);
+        if (access & PAGE_HOOK_READ) {
+            debugger->watchRead[a >> 3] = set ? debugger->watchRead[a >> 3] | bit : debugger->watchRead[a >> 3] & ~bit;
+        }
+        if (access & PAGE_HOOK_WRITE) {
+            debugger->watchWrite[a >> 3] = set ? debugger->watchWrite[a >> 3] | bit : debugger->watchWrite[a >> 3] & ~bit;
+        }
+    }
+
+    for (int page = (address >> 8); page <= ((address + length - 1) >> 8) && page < 256; page++) {
+        state->pageHooks[page] = (pageWatched(debugger->watchRead, page) ? PAGE_HOOK_READ : 0) |
+                                 (pageWatched(debugger->watchWrite, page) ? PAGE_HOOK_WRITE : 0);
+    }
+}
+
+static void printRegisters (const i8080* state) {
+    char text[32];
+    disassemble(state->memory, state->pc, text, sizeof(text));
+    printf("PC=%04X SP=%04X A=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X %c%c%c%c%c IE=%d cycles=%llu\n",
+           state->pc, state->sp, state->a, state->b, state->c, state->d, state->e, state->h, state->l,
+           state->cc.s ? 'S' : '-', state->cc.z ? 'Z' : '-', state->cc.ac ? 'A' : '-',
+           state->cc.p ? 'P' : '-', state->cc.c ? 'C' : '-', state->IE, (unsigned long long) state->cycles);
+    printf("%04X  %s\n", state->pc, text);
+}
+
+static void printMemory (const i8080* state, uint16_t address, int length) {
+    for (int row = 0; row < length; row += 16) {
+        printf("%04X ", (uint16_t)(address + row));
+        for (int i = 0; i < 16 && row + i < length; i++) {
+            printf(" %02X", state->memory[(uint16_t)(address + row + i)]);
+        }
+        printf("\n");
+    }
+}
+
+static void printListing (const Debugger* debugger, const i8080* state, uint16_t address, int count) {
+    char text[32];
+    for (int i = 0; i < count; i++) {
+        int length = disassemble(state->memory, address, text, sizeof(text));
+        printf("%c%c %04X  %s\n", debuggerBit(debugger->breakpoints, address) ? '*' : ' ',
+               address == state->pc ? '>' : ' ', address, text);
+        address += length;
+    }
+}
+
+static void printHelp (void) {
+    printf("s [n]         step n instructions\n"
+           "c             continue\n"
+           "b [addr]      set a breakpoint, or list them\n"
+           "d addr        delete a breakpoint\n"
+           "w addr [len]  watch writes, or list watchpoints\n"
+           "rw addr [len] watch reads\n"
+           "aw addr [len] watch reads and writes\n"
+           "uw addr [len] remove watchpoints\n"
+           "r             registers\n"
+           "m addr [len]  memory dump\n"
+           "l [addr] [n]  disassemble\n"
+           "q             quit\n");
+}
+
+// returns false when the user quits
+static bool debuggerPrompt (Debugger* debugger, i8080* state) {
+    char line[64];
+    printRegisters(state);
+    for (;;) {
+        printf("(i8080) ");
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin)) {
+            return false;
+        }
+        if (line[0] == '\n') {
+            strcpy(line, debugger->last[0] ? debugger->last : "s\n");
+        }
+        else {
+            strcpy(debugger->last, line);
+        }
+
+        char command[16] = {0};
+        unsigned int first = 0, second = 0;
+        int fields = sscanf(line, "%15s %x %x", command, &first, &second);
+        if (strcmp(command, "s") == 0) {
+            debugger->stepping = true;
+            debugger->steps = fields > 1 && first ? first : 1;
+            return true;
+        }
+        else if (strcmp(command, "c") == 0) {
+            debugger->stepping = false;
+            return true;
+        }
+        else if (strcmp(command, "b") == 0 && fields > 1) {
+            debuggerSetBreak(debugger, state, (uint16_t) first, true);
+        }
+        else if (strcmp(command, "b") == 0) {
+            for (int a = 0; a < MEMORY_SIZE; a++) {
+                if (debuggerBit(debugger->breakpoints, a)) {
+                    printf("  %04X\n", a);
+                }
+            }
+        }
+        else if (strcmp(command, "d") == 0 && fields > 1) {
+            debuggerSetBreak(debugger, state, (uint16_t) first, false);
+        }
+        else if (strcmp(command, "w") == 0 && fields == 1) {
+            for (int a = 0; a < MEMORY_SIZE; a++) {
+                bool read = debuggerBit(debugger->watchRead, a);
+                bool write = debuggerBit(debugger->watchWrite, a);
+                if (read || write) {
+                    printf("  %04X %s%s\n", a, read ? "r" : "", write ? "w" : "");
+                }
+            }
+        }
+        else if ((strcmp(command, "w") == 0 || strcmp(command, "rw") == 0 ||
+                  strcmp(command, "aw") == 0 || strcmp(command, "uw") == 0) && fields > 1) {
+            int access = command[0] == 'w' ? PAGE_HOOK_WRITE : command[0] == 'r' ? PAGE_HOOK_READ : PAGE_HOOK_READ | PAGE_HOOK_WRITE;
+            debuggerSetWatch(debugger, state, (uint16_t) first, fields > 2 ? (int) second : 1, access, command[0] != 'u');
+        }
+        else if (strcmp(command, "r") == 0) {
+            printRegisters(state);
+        }
+        else if (strcmp(command, "m") == 0) {
+            printMemory(state, (uint16_t) first, fields > 2 ? (int) second : 64);
+        }
+        else if (strcmp(command, "l") == 0) {
+            printListing(debugger, state, fields > 1 ? (uint16_t) first : state->pc, fields > 2 ? (int) second : 10);
+        }
+        else if (strcmp(command, "q") == 0) {
+            return false;
+        }
+        else {
+            printHelp();
+        }
+    }
+}
+
+static bool debuggerHalt (Debugger* debugger, i8080* state, int sig) {
+    if (debugger->remote) {
+        return debugger->remote(debugger->remoteContext, state, sig);
+    }
+    return debuggerPrompt(debugger, state);
+}
+
+// called before each instruction of a watched block; returns false on quit
+bool debuggerStop (Debugger* debugger, i8080* state) {
+    if (debugger->watchHit) {
+        // the hit stays visible while halted so a remote can report it
+        state->trap = false;
+        if (!debugger->remote && debugger->hitAccess == PAGE_HOOK_WRITE) {
+            printf("watchpoint: write %04X = %02X (was %02X)\n", debugger->hitAddress, debugger->hitValue, debugger->hitOld);
+        }
+        else if (!debugger->remote) {
+            printf("watchpoint: read %04X = %02X\n", debugger->hitAddress, debugger->hitValue);
+        }
+        bool resume = debuggerHalt(debugger, state, SIGTRAP);
+        debugger->watchHit = false;
+        return resume;
+    }
+    if (debugger->interrupt) {
+        debugger->interrupt = 0;
+        if (!debugger->remote) {
+            printf("\ninterrupted\n");
+        }
+        return debuggerHalt(debugger, state, SIGINT);
+    }
+    if (debuggerBit(debugger->breakpoints, state->pc)) {
+        if (!debugger->remote) {
+            printf("breakpoint at %04X\n", state->pc);
+        }
+        return debuggerHalt(debugger, state, SIGTRAP);
+    }
+    if (debugger->stepping && (debugger->steps == 0 || --debugger->steps == 0)) {
+        return debuggerHalt(debugger, state, SIGTRAP);
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i8080.h"
+
+// interactive debugger driven from the run loop
+// breakpoints cost nothing per instruction: the run loop only tests
+// blockBreaks when a basic block starts, and single-steps that one block
+// (testing breakpoints) when its straight-line path can reach a breakpoint.
+// watchpoints flag their 256-byte pages in state->pageHooks so only accesses
+// to those pages leave the direct memory path
+
+typedef struct Debugger Debugger;
+
+// replaces the console prompt when a remote debugger is attached; called on
+// the emulation thread with the signal to report, returns false to quit
+typedef bool (*DebuggerRemote)(void* context, i8080* state, int signal);
+
+struct Debugger {
+    uint8_t breakpoints[MEMORY_SIZE / 8];   // one bit per address
+    uint8_t blockBreaks[MEMORY_SIZE / 8];   // block starts whose fall-through path hits a breakpoint
+    int count;
+    bool stepping;
+    uint32_t steps;                         // instructions left before stepping stops again
+    volatile int interrupt;                 // set from SIGINT, handled at the next block
+    char last[64];                          // command repeated on an empty line
+
+    uint8_t watchRead[MEMORY_SIZE / 8];
+    uint8_t watchWrite[MEMORY_SIZE / 8];
+    bool watchHit;
+    int hitAccess;
+    uint16_t hitAddress;
+    uint8_t hitValue;
+    uint8_t hitOld;
+
+    DebuggerRemote remote;
+    void* remoteContext;
+};
+
+Debugger* debuggerCreate (bool stopAtStart);
+void debuggerDestroy (Debugger* debugger);
+void debuggerSetBreak (Debugger* debugger, const i8080* state, uint16_t address, bool set);
+void debuggerSetWatch (Debugger* debugger, i8080* state, uint16_t address, int length, int access, bool set);
+bool debuggerStop (Debugger* debugger, i8080* state);
+
+static inline bool debuggerBit (const uint8_t* bitmap, uint16_t address) {
+    return (bitmap[address >> 3] >> (address & 7)) & 1;
+}
+
+// called at every block boundary; true when the block must be single-stepped
+static inline bool debuggerWatchBlock (const Debugger* debugger, uint16_t pc) {
+    return debugger->stepping || debugger->interrupt || debugger->watchHit || debuggerBit(debugger->blockBreaks, pc);
+}
+
+#endif
@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "opcodes.h"
+#include "gdbstub.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define GDB_REGISTERS 13
+
+enum { GDB_REPLY, GDB_RESUME, GDB_KILL };
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static int hexValue (char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int sendAll (int fd, const char* data, size_t length) {
+    while (length) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+// called from both threads, the reader for acks and the emulation thread for replies
+static void gdbSend (GdbStub* stub, const char* payload) {
+    static char frame[GDB_PACKET_SIZE + 4];
+    uint8_t checksum = 0;
+    size_t length = strlen(payload);
+    pthread_mutex_lock(&stub->sendLock);
+    frame[0] = '$';
+    for (size_t i = 0; i < length; i++) {
+        frame[i + 1] = payload[i];
+        checksum += (uint8_t) payload[i];
+    }
+    frame[length + 1] = '#';
+    frame[length + 2] = hexDigits[checksum >> 4];
+    frame[length + 3] = hexDigits[checksum & 15];
+    if (stub->client >= 0) {
+        sendAll(stub->client, frame, length + 4);
+    }
+    pthread_mutex_unlock(&stub->sendLock);
+}
+
+static void gdbAck (GdbStub* stub, char ack) {
+    pthread_mutex_lock(&stub->sendLock);
+    if (stub->client >= 0) {
+        sendAll(stub->client, &ack, 1);
+    }
+    pthread_mutex_unlock(&stub->sendLock);
+}
+
+// reads the next well-formed packet into out; a bare 0x03 (Ctrl-C in gdb)
+// only raises the debugger interrupt. false once the connection is gone
+static bool readPacket (GdbStub* stub, int fd, char* out) {
+    char c;
+    for (;;) {
+        if (recv(fd, &c, 1, 0) != 1) {
+            return false;
+        }
+        if (c == 0x03) {
+            stub->debugger->interrupt = 1;
+            continue;
+        }
+        if (c != '$') {
+            continue;               // acks from gdb and line noise
+        }
+
+        size_t length = 0;
+        uint8_t checksum = 0;
+        bool overflow = false;
+        while (recv(fd, &c, 1, 0) == 1 && c != '#') {
+            if (length < GDB_PACKET_SIZE - 1) {
+                out[length++] = c;
+            }
+            else {
+                overflow = true;
+            }
+            checksum += (uint8_t) c;
+        }
+        char sum[2];
+        if (c != '#' || recv(fd, &sum[0], 1, 0) != 1 || recv(fd, &sum[1], 1, 0) != 1) {
+            return false;
+        }
+        out[length] = '\0';
+        if (overflow || hexValue(sum[0]) * 16 + hexValue(sum[1]) != checksum) {
+            gdbAck(stub, '-');
+            continue;
+        }
+        gdbAck(stub, '+');
+        return true;
+    }
+}
+
+static void* gdbReader (void* arg) {
+    GdbStub* stub = arg;
+    char packet[GDB_PACKET_SIZE];
+    while (!stub->quit) {
+        int client = accept(stub->listener, NULL, NULL);
+        if (client < 0) {
+            break;
+        }
+
+        pthread_mutex_lock(&stub->lock);
+        pthread_mutex_lock(&stub->sendLock);
+        stub->client = client;
+        pthread_mutex_unlock(&stub->sendLock);
+        stub->connected = true;
+        stub->resumed = false;
+        pthread_mutex_unlock(&stub->lock);
+        stub->debugger->interrupt = 1;      // gdb expects a stopped target on attach
+
+        while (readPacket(stub, client, packet)) {
+            pthread_mutex_lock(&stub->lock);
+            while (stub->pending && stub->connected) {
+                pthread_cond_wait(&stub->cond, &stub->lock);
+            }
+            strcpy(stub->request, packet);
+            stub->pending = true;
+            pthread_cond_broadcast(&stub->cond);
+            pthread_mutex_unlock(&stub->lock);
+        }
+
+        pthread_mutex_lock(&stub->lock);
+        pthread_mutex_lock(&stub->sendLock);
+        stub->client = -1;
+        pthread_mutex_unlock(&stub->sendLock);
+        stub->connected = false;
+        stub->pending = false;
+        pthread_cond_broadcast(&stub->cond);
+        pthread_mutex_unlock(&stub->lock);
+        close(client);
+    }
+    return NULL;
+}
+
+static uint8_t packFlags (const i8080* state) {
+    return (state->cc.c ? CARRY_MASK : 0) |
+           (state->cc.p ? PARITY_MASK : 0) |
+           (state->cc.ac ? AC_MASK : 0) |
+           (state->cc.z ? ZERO_MASK : 0) |
+           (state->cc.s ? SIGN_MASK : 0) | 0x02;
+}
+
+static uint16_t readRegister (const i8080* state, int n) {
+    switch (n) {
+        case 0: return (state->a << 8) | packFlags(state);
+        case 1: return state->bc;
+        case 2: return state->de;
+        case 3: return state->hl;
+        case 4: return state->sp;
+        case 5: return state->pc;
+        default: return 0;
+    }
+}
+
+static void writeRegister (i8080* state, int n, uint16_t value) {
+    switch (n) {
+        case 0:
+            state->a = HIGH_BYTE(value);
+            state->cc.c = (value & CARRY_MASK) != 0;
+            state->cc.p = (value & PARITY_MASK) != 0;
+            state->cc.ac = (value & AC_MASK) != 0;
+            state->cc.z = (value & ZERO_MASK) != 0;
+            state->cc.s = (value & SIGN_MASK) != 0;
+            break;
+        case 1: state->bc = value; break;
+        case 2: state->de = value; break;
+        case 3: state->hl = value; break;
+        case 4: state->sp = value; break;
+        case 5: state->pc = value; break;
+    }
+}
+
+// 16-bit register values go over the wire little endian, as four hex digits
+static char* putWord (char* out, uint16_t value) {
+    *out++ = hexDigits[(value >> 4) & 15];
+    *out++ = hexDigits[value & 15];
+    *out++ = hexDigits[(value >> 12) & 15];
+    *out++ = hexDigits[(value >> 8) & 15];
+    return out;
+}
+
+static bool getWord (const char* in, uint16_t* value) {
+    int digits[4];
+    for (int i = 0; i < 4; i++) {
+        if ((digits[i] = hexValue(in[i])) < 0) {
+            return false;
+        }
+    }
+    *value = (digits[2] << 12) | (digits[3] << 8) | (digits[0] << 4) | digits[1];
+    return true;
+}
+
+static void stopReply (const GdbStub* stub, int sig, char* reply) {
+    const Debugger* debugger = stub->debugger;
+    if (debugger->watchHit) {
+        uint16_t a = debugger->hitAddress;
+        bool both = debuggerBit(debugger->watchRead, a) && debuggerBit(debugger->watchWrite, a);
+        const char* kind = both ? "awatch" : debugger->hitAccess == PAGE_HOOK_WRITE ? "watch" : "rwatch";
+        sprintf(reply, "T%02x%s:%04x;", sig, kind, a);
+    }
+    else {
+        sprintf(reply, "S%02x", sig);
+    }
+}
+
+// Z/z type,addr,kind: 0 and 1 are breakpoints, 2 write, 3 read and 4 access watchpoints
+static bool setPoint (GdbStub* stub, i8080* state, const char* packet) {
+    unsigned int type, address, kind;
+    if (sscanf(packet + 1, "%x,%x,%x", &type, &address, &kind) != 3 || type > 4) {
+        return false;
+    }
+    bool set = packet[0] == 'Z';
+    if (type < 2) {
+        debuggerSetBreak(stub->debugger, state, (uint16_t) address, set);
+    }
+    else {
+        int access = type == 2 ? PAGE_HOOK_WRITE : type == 3 ? PAGE_HOOK_READ : PAGE_HOOK_READ | PAGE_HOOK_WRITE;
+        debuggerSetWatch(stub->debugger, state, (uint16_t) address, kind ? (int) kind : 1, access, set);
+    }
+    return true;
+}
+
+static int gdbHandle (GdbStub* stub, i8080* state, int sig, const char* packet, char* reply) {
+    Debugger* debugger = stub->debugger;
+    unsigned int address, length, n;
+    uint16_t value;
+    char* out = reply;
+    reply[0] = '\0';
+
+    switch (packet[0]) {
+        case '?':
+            stopReply(stub, sig, reply);
+            break;
+        case 'g':
+            for (int i = 0; i < GDB_REGISTERS; i++) {
+                out = putWord(out, readRegister(state, i));
+            }
+            *out = '\0';
+            break;
+        case 'G':
+            for (int i = 0; i < GDB_REGISTERS && getWord(packet + 1 + i * 4, &value); i++) {
+                writeRegister(state, i, value);
+            }
+            strcpy(reply, "OK");
+            break;
+        case 'p':
+            if (sscanf(packet + 1, "%x", &n) == 1) {
+                *putWord(out, readRegister(state, n)) = '\0';
+            }
+            break;
+        case 'P':
+            if (sscanf(packet + 1, "%x=", &n) == 1 && getWord(strchr(packet, '=') + 1, &value)) {
+                writeRegister(state, n, value);
+                strcpy(reply, "OK");
+            }
+            else {
+                strcpy(reply, "E01");
+            }
+            break;
+        case 'm':
+            if (sscanf(packet + 1, "%x,%x", &address, &length) != 2) {
+                strcpy(reply, "E01");
+                break;
+            }
+            for (unsigned int i = 0; i < length && i < GDB_PACKET_SIZE / 2 - 1; i++) {
+                uint8_t byte = state->memory[(uint16_t)(address + i)];
+                *out++ = hexDigits[byte >> 4];
+                *out++ = hexDigits[byte & 15];
+            }
+            *out = '\0';
+            break;
+        case 'M': {
+            const char* data = strchr(packet, ':');
+            if (!data || sscanf(packet + 1, "%x,%x", &address, &length) != 2) {
+                strcpy(reply, "E01");
+                break;
+            }
+            // goes straight to memory: gdb pokes are not guest accesses and must not trip watchpoints
+            for (unsigned int i = 0; i < length && data[1 + i * 2] && data[2 + i * 2]; i++) {
+                state->memory[(uint16_t)(address + i)] = hexValue(data[1 + i * 2]) * 16 + hexValue(data[2 + i * 2]);
+            }
+            strcpy(reply, "OK");
+            break;
+        }
+        case 'c':
+        case 's':
+            if (sscanf(packet + 1, "%x", &address) == 1) {
+                state->pc = (uint16_t) address;
+            }
+            debugger->stepping = packet[0] == 's';
+            debugger->steps = 1;
+            return GDB_RESUME;
+        case 'Z':
+        case 'z':
+            strcpy(reply, setPoint(stub, state, packet) ? "OK" : "");
+            break;
+        case 'H':
+            strcpy(reply, "OK");
+            break;
+        case 'q':
+            if (strncmp(packet, "qSupported", 10) == 0) {
+                sprintf(reply, "PacketSize=%x", GDB_PACKET_SIZE);
+            }
+            else if (strcmp(packet, "qAttached") == 0) {
+                strcpy(reply, "1");
+            }
+            break;
+        case 'D':
+            strcpy(reply, "OK");
+            gdbSend(stub, reply);
+            debugger->stepping = false;
+            return GDB_RESUME;
+        case 'k':
+            return GDB_KILL;
+    }
+    return GDB_REPLY;
+}
+
+// DebuggerRemote: serves gdb on the emulation thread until it resumes the target
+static bool gdbStopped (void* context, i8080* state, int sig) {
+    GdbStub* stub = context;
+    char packet[GDB_PACKET_SIZE];
+    char reply[GDB_PACKET_SIZE];
+
+    pthread_mutex_lock(&stub->lock);
+    if (stub->resumed) {
+        stub->resumed = false;
+        stopReply(stub, sig, reply);
+        gdbSend(stub, reply);
+    }
+    for (;;) {
+        while (!stub->pending && stub->connected) {
+            pthread_cond_wait(&stub->cond, &stub->lock);
+        }
+        if (!stub->connected) {
+            pthread_mutex_unlock(&stub->lock);
+            stub->debugger->stepping = false;   // gdb went away, keep running
+            return true;
+        }
+        strcpy(packet, stub->request);
+        stub->pending = false;
+        pthread_cond_broadcast(&stub->cond);
+        pthread_mutex_unlock(&stub->lock);
+
+        int action = gdbHandle(stub, state, sig, packet, reply);
+        if (action == GDB_KILL) {
+            return false;
+        }
+        pthread_mutex_lock(&stub->lock);
+        if (action == GDB_RESUME) {
+            stub->resumed = packet[0] != 'D';
+            pthread_mutex_unlock(&stub->lock);
+            return true;
+        }
+        gdbSend(stub, reply);
+    }
+}
+
+static int gdbListen (const char* address) {
+    char* end;
+    long port = strtol(address, &end, 10);
+    int fd;
+    if (*end == '\0' && port > 0 && port < 65536) {
+        struct sockaddr_in in = {0};
+        in.sin_family = AF_INET;
+        in.sin_port = htons((uint16_t) port);
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int yes = 1;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*) &yes, sizeof(yes));
+        }
+        if (fd < 0 || bind(fd, (struct sockaddr*) &in, sizeof(in)) != 0) {
+            fd = fd < 0 ? fd : (close(fd), -1);
+        }
+    }
+    else {
+        struct sockaddr_un un = {0};
+        un.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(un.sun_path)) {
+            return -1;
+        }
+        strcpy(un.sun_path, address);
+        unlink(address);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && bind(fd, (struct sockaddr*) &un, sizeof(un)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0 && listen(fd, 1) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+GdbStub* gdbCreate (Debugger* debugger, const char* address) {
+    GdbStub* stub = calloc(1, sizeof(GdbStub));
+    if (!stub) {
+        return NULL;
+    }
+    stub->listener = gdbListen(address);
+    if (stub->listener < 0) {
+        fprintf(stderr, "Error: Could not listen for gdb on %s\n", address);
+        free(stub);
+        return NULL;
+    }
+    stub->debugger = debugger;
+    stub->client = -1;
+    pthread_mutex_init(&stub->lock, NULL);
+    pthread_cond_init(&stub->cond, NULL);
+    pthread_mutex_init(&stub->sendLock, NULL);
+    if (pthread_create(&stub->thread, NULL, gdbReader, stub) != 0) {
+        fprintf(stderr, "Error: Could not start gdb thread\n");
+        close(stub->listener);
+        free(stub);
+        return NULL;
+    }
+    debugger->remote = gdbStopped;
+    debugger->remoteContext = stub;
+    return stub;
+}
+
+void gdbDestroy (GdbStub* stub) {
+    stub->debugger->remote = NULL;
+    stub->quit = true;
+    shutdown(stub->listener, SHUT_RDWR);        // wakes accept
+    pthread_mutex_lock(&stub->sendLock);
+    if (stub->client >= 0) {
+        shutdown(stub->client, SHUT_RDWR);      // wakes recv
+    }
+    pthread_mutex_unlock(&stub->sendLock);
+    pthread_join(stub->thread, NULL);
+    close(stub->listener);
+    pthread_mutex_destroy(&stub->lock);
+    pthread_cond_destroy(&stub->cond);
+    pthread_mutex_destroy(&stub->sendLock);
+    free(stub);
+}
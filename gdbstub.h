@@ -0,0 +1,41 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "i8080.h"
+#include "debugger.h"
+
+// gdb remote serial protocol server, compiled in with -DI8080_GDB
+// a reader thread owns the socket and the packet framing; commands that touch
+// the cpu are handed to the emulation thread, which only picks them up while
+// it is parked in the debugger at a block boundary. while gdb is attached but
+// the target runs, the run loop does nothing beyond the debugger's usual
+// per-block test.
+//
+// registers use gdb's z80 layout (set architecture z80), 16-bit little endian:
+// af bc de hl sp pc, followed by the z80-only ix iy af' bc' de' hl' ir as zero
+
+#define GDB_PACKET_SIZE 4096
+
+typedef struct {
+    Debugger* debugger;
+    int listener;
+    int client;                     // -1 while no gdb is connected
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_mutex_t sendLock;
+    bool pending;                   // request holds a packet for the emulation thread
+    bool connected;
+    bool resumed;                   // gdb is waiting for a stop reply
+    bool quit;
+    char request[GDB_PACKET_SIZE];
+} GdbStub;
+
+// address is a port number on localhost or, anything else, a unix socket path
+GdbStub* gdbCreate (Debugger* debugger, const char* address);
+void gdbDestroy (GdbStub* stub);
+
+#endif
@@ -0,0 +1,57 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "opcodes.h"
+#include "i8080.h"
+
+void initializeState(i8080* state) {
+    state->a = 0x00;
+    state->b = 0x00;
+    state->c = 0x00;
+    state->d = 0x00;
+    state->e = 0x00;
+    state->h = 0x00;
+    state->l = 0x00;
+    state->sp = 0x0000;
+    state->pc = 0x0000;
+    state->cycles = 0;
+    state->halt = 0;
+    state->IE = 1;
+    loadSplitFlags(state);
+}
+
+// split flag instances keep the flags in flagResult, flagAux and flagCarry instead
+// of cc. load before running one on a state whose cc was set directly, sync
+// before anything reads cc after it
+void loadSplitFlags (i8080* state) {
+    state->flagResult = SZP_DIRECT | (state->cc.s ? SIGN_MASK : 0) | (state->cc.z ? ZERO_MASK : 0) |
+                        (state->cc.p ? PARITY_MASK : 0);
+    state->flagAux = state->cc.ac ? AC_MASK : 0;
+    state->flagCarry = state->cc.c;
+}
+
+void syncSplitFlags (i8080* state) {
+    uint8_t flags = szpTable[state->flagResult];
+    state->cc.z = (flags & ZERO_MASK) != 0;
+    state->cc.s = (flags & SIGN_MASK) != 0;
+    state->cc.p = (flags & PARITY_MASK) != 0;
+    state->cc.ac = (state->flagAux & AC_MASK) != 0;
+    state->cc.c = state->flagCarry;
+}
+
+// the general core: memory hooks, port callbacks and traps all honoured
+#define CORE_STEP opcodeExtract
+#define CORE_LINKAGE
+#include "i8080core.h"
+
+// RST n from the interrupt controller; ignored while interrupts are disabled.
+// true when the RST was taken
+bool generateInterrupt (i8080* state, int number) {
+    if (!state->IE) {
+        return false;
+    }
+    state->IE = 0;
+    state->halt = 0;
+    opcodeExtract_rst(state, number * 8);
+    state->cycles += opcodeTable[0xC7].cycles;
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef I8080_H
+#define I8080_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MEMORY_SIZE 65536
+#define HIGH_BYTE(reg) ((uint8_t)((reg >> 8) & 0xFF))
+#define LOW_BYTE(reg) ((uint8_t)(reg & 0xFF))
+#define SET_HIGH_BYTE(reg, value) ((reg) = ((reg) & 0x00FF) | ((value) << 8))
+
+// a register pair overlaid on its two halves, so state->hl is H and L read
+// as one 16-bit value and state->h is still the high byte on any host
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define REGISTER_PAIR(high, low) union { uint16_t high##low; struct { uint8_t high; uint8_t low; }; }
+#else
+#define REGISTER_PAIR(high, low) union { uint16_t high##low; struct { uint8_t low; uint8_t high; }; }
+#endif
+
+typedef struct {
+    uint8_t z : 1;
+    uint8_t s : 1;
+    uint8_t p : 1;
+    uint8_t c : 1;
+    uint8_t ac : 1;
+    uint8_t pad : 3;
+} ConditionCodes;
+
+#define PAGE_HOOK_READ 0x01
+#define PAGE_HOOK_WRITE 0x02
+
+typedef struct i8080 i8080;
+struct ShadowStack;     // profile.h
+
+// called for data accesses to pages flagged in pageHooks, before a write lands
+typedef void (*MemoryHook) (i8080* state, uint16_t address, uint8_t value, int access);
+
+// port handlers for IN/OUT; without them IN leaves A alone and OUT is dropped
+typedef uint8_t (*PortIn) (i8080* state, uint8_t port);
+typedef void (*PortOut) (i8080* state, uint8_t port, uint8_t value);
+
+struct i8080 {
+    bool IE;
+    bool halt;
+    uint8_t a;
+    REGISTER_PAIR(b, c);
+    REGISTER_PAIR(d, e);
+    REGISTER_PAIR(h, l);
+    uint16_t sp;
+    uint16_t pc;
+    uint64_t cycles;
+
+    ConditionCodes cc;
+    uint16_t flagResult;    // split flag instances: S, Z and P are szpTable[flagResult]
+    uint8_t flagAux;        // and AC is bit 4 of this, carry is flagCarry; see loadSplitFlags
+    uint8_t flagCarry;
+    struct ShadowStack* shadow;     // maintained by call/ret/rst while sampling, otherwise NULL
+    bool trap;              // set by a memory hook to end the current block after this instruction
+    MemoryHook memoryHook;
+    void* hookContext;
+    PortIn portIn;
+    PortOut portOut;
+    void* ioContext;
+    uint8_t pageHooks[MEMORY_SIZE >> 8];    // PAGE_HOOK_ bits per 256-byte page
+    uint8_t memory[MEMORY_SIZE];
+
+};
+
+// data accesses from the core; pages without hooks go straight to memory
+static inline uint8_t readByte (i8080* state, uint16_t address) {
+    if (state->pageHooks[address >> 8] & PAGE_HOOK_READ) {
+        state->memoryHook(state, address, state->memory[address], PAGE_HOOK_READ);
+    }
+    return state->memory[address];
+}
+
+static inline void writeByte (i8080* state, uint16_t address, uint8_t value) {
+    if (state->pageHooks[address >> 8] & PAGE_HOOK_WRITE) {
+        state->memoryHook(state, address, value, PAGE_HOOK_WRITE);
+    }
+    state->memory[address] = value;
+}
+
+void initializeState(i8080* state);
+int opcodeExtract (i8080* state);
+void loadSplitFlags (i8080* state);
+void syncSplitFlags (i8080* state);
+bool generateInterrupt (i8080* state, int number);
+
+#endif
@@ -0,0 +1,1286 @@
+#ifndef I8080_CORE_H
+#define I8080_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "opcodes.h"
+#include "i8080.h"
+#include "profile.h"
+
+// the interpreter as a template. define CORE_STEP (the name of the step
+// function) and any of the policies below, then include this file; every
+// include produces its own step function with the policies expanded inline,
+// so a front end that knows its memory map and ports pays no hook checks or
+// function pointer calls per access. i8080.c instantiates the default
+// opcodeExtract that everything else falls back to
+//
+//   CORE_LINKAGE                       storage of the step function, default static inline
+//   CORE_READ(state, address)          data read, default readByte (per-page hooks)
+//   CORE_WRITE(state, address, value)  data write, default writeByte
+//   CORE_TRAP(state)                   ends the block early, default state->trap; policies
+//                                      without memory hooks define it as 0
+//   CORE_IN(state, port)               IN, default state->portIn or A unchanged
+//   CORE_OUT(state, port, value)       OUT, default state->portOut or dropped
+//   CORE_TRACE(state)                  before each instruction, default nothing
+//   CORE_CYCLES(state, states)         cycle accounting, default state->cycles += states
+//   CORE_SHADOW_CALL(state, entry, ret) CALL/RST taken, default pushes on state->shadow
+//   CORE_SHADOW_RET(state, ret)        RET taken, default pops state->shadow; both are
+//                                      for the sampler (profile.h), which fast cores never run
+//   CORE_SPLIT_FLAGS                   defined: flags kept apart from cc, see below
+//   CORE_KEEP_NAMES                    defined: the policies, helper names and flag macros
+//                                      stay defined after the include, for code written
+//                                      against them (the recompiled rom, tools/recompile.c)
+//
+// instruction fetch and operands always read state->memory directly.
+// the policies are undefined again at the end of this file
+
+// register and flag helpers, the same for every instance
+
+// S, Z and P come from szpTable (opcodes.c)
+static inline void ZSP (i8080* state, uint8_t answer) {
+    uint8_t flags = szpTable[answer];
+    state->cc.z = (flags & ZERO_MASK) != 0;
+    state->cc.s = (flags & SIGN_MASK) != 0;
+    state->cc.p = (flags & PARITY_MASK) != 0;
+}
+
+static inline void inx (uint16_t* pair) {
+    *pair += 1;
+}
+
+static inline void dcx (uint16_t* pair) {
+    *pair -= 1;
+}
+
+// operands of the instruction at pc
+static inline uint16_t getNextWord (i8080* state, uint16_t pc) {
+    return (state->memory[(uint16_t)(pc + 2)] << 8) | state->memory[(uint16_t)(pc + 1)];
+}
+
+static inline uint8_t getNextByte (i8080* state, uint16_t pc) {
+    return state->memory[(uint16_t)(pc + 1)];
+}
+
+static inline void jnx (i8080* state, uint8_t flag, uint16_t address) {
+    if (flag == 0) {
+        state->pc = address;
+    }
+}
+
+static inline void jx (i8080* state, uint8_t flag, uint16_t address) {
+    if (flag != 0) {
+        state->pc = address;
+    }
+}
+
+static inline void lxi (uint16_t* pair, uint16_t value) {
+    *pair = value;
+}
+
+static inline void mvi (uint8_t* reg, uint8_t value) {
+    *reg = value;
+}
+
+static inline void mov (uint8_t* lsr, uint8_t rsr) {
+    *lsr = rsr;
+}
+
+#define CORE_PASTE2(a, b) a##_##b
+#define CORE_PASTE(a, b) CORE_PASTE2(a, b)
+#define CORE_FN(name) CORE_PASTE(CORE_STEP, name)   // per-instance helper name
+
+#endif
+
+#ifndef CORE_STEP
+#error "define CORE_STEP before including i8080core.h"
+#endif
+
+#ifndef CORE_LINKAGE
+#define CORE_LINKAGE static inline
+#endif
+#ifndef CORE_READ
+#define CORE_READ(state, address) readByte(state, address)
+#endif
+#ifndef CORE_WRITE
+#define CORE_WRITE(state, address, value) writeByte(state, address, value)
+#endif
+#ifndef CORE_TRAP
+#define CORE_TRAP(state) ((state)->trap)
+#endif
+#ifndef CORE_IN
+#define CORE_IN(state, port) ((state)->portIn ? (state)->portIn(state, port) : (state)->a)
+#endif
+#ifndef CORE_OUT
+#define CORE_OUT(state, port, value) ((state)->portOut ? (state)->portOut(state, port, value) : (void) 0)
+#endif
+#ifndef CORE_TRACE
+#define CORE_TRACE(state)
+#endif
+#ifndef CORE_CYCLES
+#define CORE_CYCLES(state, states) ((state)->cycles += (states))
+#endif
+#ifndef CORE_SHADOW_CALL
+#define CORE_SHADOW_CALL(state, entry, ret) ((state)->shadow ? shadowCall((state)->shadow, entry, ret) : (void) 0)
+#endif
+#ifndef CORE_SHADOW_RET
+#define CORE_SHADOW_RET(state, ret) ((state)->shadow ? shadowRet((state)->shadow, ret) : (void) 0)
+#endif
+
+// helpers that touch memory or the cycle count are compiled once per
+// instance; these names keep the switch below reading like plain calls
+#define dad(...) CORE_FN(dad)(__VA_ARGS__)
+#define rlc(...) CORE_FN(rlc)(__VA_ARGS__)
+#define ral(...) CORE_FN(ral)(__VA_ARGS__)
+#define rrc(...) CORE_FN(rrc)(__VA_ARGS__)
+#define rar(...) CORE_FN(rar)(__VA_ARGS__)
+#define arithmeticAll(...) CORE_FN(arithmeticAll)(__VA_ARGS__)
+#define add(...) CORE_FN(add)(__VA_ARGS__)
+#define addC(...) CORE_FN(addC)(__VA_ARGS__)
+#define sub(...) CORE_FN(sub)(__VA_ARGS__)
+#define subC(...) CORE_FN(subC)(__VA_ARGS__)
+#define inr(...) CORE_FN(inr)(__VA_ARGS__)
+#define dcr(...) CORE_FN(dcr)(__VA_ARGS__)
+#define daa(...) CORE_FN(daa)(__VA_ARGS__)
+#define ana(...) CORE_FN(ana)(__VA_ARGS__)
+#define anaI(...) CORE_FN(anaI)(__VA_ARGS__)
+#define ora(...) CORE_FN(ora)(__VA_ARGS__)
+#define xra(...) CORE_FN(xra)(__VA_ARGS__)
+#define cmp(...) CORE_FN(cmp)(__VA_ARGS__)
+#define call(...) CORE_FN(call)(__VA_ARGS__)
+#define ret(...) CORE_FN(ret)(__VA_ARGS__)
+#define cnx(...) CORE_FN(cnx)(__VA_ARGS__)
+#define cx(...) CORE_FN(cx)(__VA_ARGS__)
+#define rnx(...) CORE_FN(rnx)(__VA_ARGS__)
+#define rx(...) CORE_FN(rx)(__VA_ARGS__)
+#define rst(...) CORE_FN(rst)(__VA_ARGS__)
+#define pop(...) CORE_FN(pop)(__VA_ARGS__)
+#define push(...) CORE_FN(push)(__VA_ARGS__)
+#define popPSW(...) CORE_FN(popPSW)(__VA_ARGS__)
+#define pushPSW(...) CORE_FN(pushPSW)(__VA_ARGS__)
+#define stax(...) CORE_FN(stax)(__VA_ARGS__)
+#define shld(...) CORE_FN(shld)(__VA_ARGS__)
+#define sta(...) CORE_FN(sta)(__VA_ARGS__)
+#define ldax(...) CORE_FN(ldax)(__VA_ARGS__)
+#define lhld(...) CORE_FN(lhld)(__VA_ARGS__)
+#define lda(...) CORE_FN(lda)(__VA_ARGS__)
+
+// flag access. eager instances keep every flag in the cc bitfield.
+// CORE_SPLIT_FLAGS instances give each its own field, so that no flag update
+// is a read-modify-write of the cc byte: carry in flagCarry, AC in bit 4 of
+// flagAux, and S, Z and P as the result byte in flagResult, looked up in
+// szpTable only when an instruction reads them. that lookup is all that is
+// deferred; keeping carry in flagResult as well, with AC from the operands,
+// made INR, DCR and the rotates read it back to keep the other flags, and
+// the wait loops of the rom ran slower for it
+#ifdef CORE_SPLIT_FLAGS
+#define FLAG_C(state) ((state)->flagCarry)
+#define SET_C(state, flag) ((state)->flagCarry = (flag))
+#define FLAG_Z(state) ((szpTable[(state)->flagResult] & ZERO_MASK) != 0)
+#define FLAG_S(state) ((szpTable[(state)->flagResult] & SIGN_MASK) != 0)
+#define FLAG_P(state) ((szpTable[(state)->flagResult] & PARITY_MASK) != 0)
+#define FLAG_AC(state) (((state)->flagAux & AC_MASK) != 0)
+#define SET_SZP(state, answer) ((state)->flagResult = (uint8_t) (answer))
+#define SET_AC(state, flag) ((state)->flagAux = (flag) ? AC_MASK : 0)
+// bit 4 of a ^ value ^ answer is the carry (or borrow) into bit 4
+#define SET_AC_ADD(state, x, value, answer) ((state)->flagAux = (x) ^ (value) ^ (answer))
+#define SET_AC_SUB(state, x, value, answer) ((state)->flagAux = ~((x) ^ (value) ^ (answer)))
+#else
+#define FLAG_C(state) ((state)->cc.c)
+#define SET_C(state, flag) ((state)->cc.c = (flag))
+#define FLAG_Z(state) ((state)->cc.z)
+#define FLAG_S(state) ((state)->cc.s)
+#define FLAG_P(state) ((state)->cc.p)
+#define FLAG_AC(state) ((state)->cc.ac)
+#define SET_SZP(state, answer) ZSP(state, answer)
+#define SET_AC(state, flag) ((state)->cc.ac = (flag))
+#define SET_AC_ADD(state, x, value, answer) ((state)->cc.ac = halfCarryAdd[HALF_CARRY_INDEX(x, value, answer)])
+#define SET_AC_SUB(state, x, value, answer) ((state)->cc.ac = halfCarrySub[HALF_CARRY_INDEX(x, value, answer)])
+#endif
+
+static inline void CORE_FN(dad) (i8080* state, uint16_t value) {
+    uint32_t answer = (uint32_t) state->hl + value;
+    SET_C(state, answer > 0xffff);
+    state->hl = answer;
+}
+
+static inline void CORE_FN(rlc) (i8080* state) {
+    uint8_t x = state->a;
+    state->a = (x << 1) | ((x >> 7) & 1);
+    SET_C(state, (x >> 7) & 1);
+}
+
+static inline void CORE_FN(ral) (i8080* state) {
+    uint8_t x = state->a;
+    state->a = (x << 1) | FLAG_C(state);
+    SET_C(state, (x >> 7) & 1);
+}
+
+static inline void CORE_FN(rrc) (i8080* state) {
+    uint8_t x = state->a;
+    state->a = (x << 7) | (x >> 1);
+    SET_C(state, x & 1);
+}
+
+static inline void CORE_FN(rar) (i8080* state) {
+    uint8_t x = state->a;
+    state->a = (FLAG_C(state) << 7) | (x >> 1);
+    SET_C(state, x & 1);
+}
+
+// answer is the 16-bit result, bit 8 is the carry (or borrow)
+static inline void CORE_FN(arithmeticAll) (i8080* state, uint16_t answer) {
+    SET_SZP(state, answer);
+    SET_C(state, (answer > 0xff));
+}
+
+static inline void CORE_FN(add) (i8080* state, uint16_t value) {
+    uint16_t answer = (uint16_t) state->a + (uint16_t) value;
+    arithmeticAll(state, answer);
+    SET_AC_ADD(state, state->a, value, answer);
+    state->a = answer & 0xff;
+}
+
+static inline void CORE_FN(addC) (i8080* state, uint16_t value) {
+    uint16_t answer = (uint16_t) state->a + (uint16_t) value + (uint16_t) FLAG_C(state);
+    arithmeticAll(state, answer);
+    SET_AC_ADD(state, state->a, value, answer);
+    state->a = answer & 0xff;
+}
+
+// the 8080 sets AC on subtraction when there is no borrow out of bit 3
+static inline void CORE_FN(sub) (i8080* state, uint16_t value) {
+    uint16_t answer = (uint16_t) state->a - (uint16_t)value;
+    arithmeticAll(state, answer);
+    SET_AC_SUB(state, state->a, value, answer);
+    state->a = answer & 0xff;
+}
+
+static inline void CORE_FN(subC) (i8080* state, uint16_t value) {
+    uint16_t answer = (uint16_t) state->a - (uint16_t)value - (uint16_t) FLAG_C(state);
+    arithmeticAll(state, answer);
+    SET_AC_SUB(state, state->a, value, answer);
+    state->a = answer & 0xff;
+}
+
+static inline void CORE_FN(inr) (i8080* state, uint8_t* reg) {
+    uint8_t answer = *reg + 1;
+    SET_SZP(state, answer);
+    SET_AC_ADD(state, *reg, 1, answer);
+    *reg = answer;
+}
+
+static inline void CORE_FN(dcr) (i8080* state, uint8_t* reg) {
+    uint8_t answer = *reg - 1;
+    SET_SZP(state, answer);
+    SET_AC_SUB(state, *reg, 1, answer);
+    *reg = answer;
+}
+
+static inline void CORE_FN(daa) (i8080* state) {
+    uint16_t entry = daaTable[state->a | (FLAG_C(state) ? DAA_CARRY_IN : 0) | (FLAG_AC(state) ? DAA_AC_IN : 0)];
+    state->a = entry & 0xff;
+    SET_SZP(state, state->a);
+    SET_AC(state, (entry & DAA_AC_OUT) != 0);
+    SET_C(state, (entry & DAA_CARRY_OUT) != 0);
+}
+
+// on the 8080 AND sets AC to the OR of bit 3 of both operands
+static inline void CORE_FN(ana) (i8080* state, uint8_t value) {
+    uint8_t answer = state->a & value;
+    SET_SZP(state, answer);
+    SET_C(state, 0);
+    SET_AC(state, ((state->a | value) & 0x08) != 0);
+    state->a = answer;
+}
+
+static inline void CORE_FN(anaI) (i8080* state, uint8_t value) {
+    ana(state, value);
+}
+
+static inline void CORE_FN(ora) (i8080* state, uint8_t value) {
+    uint8_t answer = state->a | value;
+    SET_SZP(state, answer);
+    SET_C(state, 0);
+    SET_AC(state, 0);
+    state->a = answer;
+}
+
+static inline void CORE_FN(xra) (i8080* state, uint8_t value) {
+    uint8_t answer = state->a ^ value;
+    SET_SZP(state, answer);
+    SET_C(state, 0);
+    SET_AC(state, 0);
+    state->a = answer;
+}
+
+static inline void CORE_FN(cmp) (i8080* state, uint8_t value) {
+    uint8_t answer = state->a - value;
+    SET_SZP(state, answer);
+    SET_C(state, state->a < value);
+    SET_AC_SUB(state, state->a, value, answer);
+}
+
+// the target is read before the return address is pushed, which may overwrite it
+static inline void CORE_FN(call) (i8080* state, uint16_t address) {
+    uint16_t ret = state->pc;
+    CORE_WRITE(state, (uint16_t)(state->sp-1), (ret >> 8) & 0xff);
+    CORE_WRITE(state, (uint16_t)(state->sp-2), (ret & 0xff));
+    state->sp = state->sp - 2;
+    state->pc = address;
+    CORE_SHADOW_CALL(state, state->pc, ret);
+}
+
+static inline void CORE_FN(ret) (i8080* state) {
+    state->pc = CORE_READ(state, state->sp) | (CORE_READ(state, (uint16_t)(state->sp+1)) << 8);
+    state->sp += 2;
+    CORE_SHADOW_RET(state, state->pc);
+}
+
+static inline void CORE_FN(cnx) (i8080* state, uint8_t flag, unsigned char* opcode, uint16_t address) {
+    if (flag == 0) {
+        CORE_CYCLES(state, opcodeTable[*opcode].cyclesTaken - opcodeTable[*opcode].cycles);
+        call (state, address);
+    }
+}
+
+static inline void CORE_FN(cx) (i8080* state, uint8_t flag, unsigned char* opcode, uint16_t address) {
+    if (flag != 0) {
+        CORE_CYCLES(state, opcodeTable[*opcode].cyclesTaken - opcodeTable[*opcode].cycles);
+        call (state, address);
+    }
+}
+
+static inline void CORE_FN(rnx) (i8080* state, uint8_t flag, unsigned char* opcode) {
+    if (flag == 0) {
+        ret (state);
+        CORE_CYCLES(state, opcodeTable[*opcode].cyclesTaken - opcodeTable[*opcode].cycles);
+    }
+}
+
+static inline void CORE_FN(rx) (i8080* state, uint8_t flag, unsigned char* opcode) {
+    if (flag != 0) {
+        ret (state);
+        CORE_CYCLES(state, opcodeTable[*opcode].cyclesTaken - opcodeTable[*opcode].cycles);
+    }
+}
+
+static inline void CORE_FN(rst) (i8080* state, uint16_t addr) {
+    uint16_t ret = state->pc;
+    CORE_WRITE(state, (uint16_t)(state->sp-1), (ret >> 8) & 0xff);
+    CORE_WRITE(state, (uint16_t)(state->sp-2), (ret & 0xff));
+    state->sp = state->sp - 2;
+    state->pc = addr;
+    CORE_SHADOW_CALL(state, addr, ret);
+}
+
+static inline void CORE_FN(pop) (i8080* state, uint16_t* pair) {
+    *pair = CORE_READ(state, state->sp) | (CORE_READ(state, (uint16_t)(state->sp+1)) << 8);
+    state->sp += 2;
+}
+
+static inline void CORE_FN(push) (i8080* state, uint16_t value) {
+    CORE_WRITE(state, (uint16_t)(state->sp-1), (value >> 8) & 0xff);
+    CORE_WRITE(state, (uint16_t)(state->sp-2), value & 0xff);
+    state->sp = state->sp - 2;
+}
+
+// flags byte in the 8080 layout: S Z 0 AC 0 P 1 C
+static inline void CORE_FN(popPSW) (i8080* state) {
+    state->a = CORE_READ(state, (uint16_t)(state->sp+1));
+    uint8_t psw = CORE_READ(state, state->sp);
+#ifdef CORE_SPLIT_FLAGS
+    state->flagResult = SZP_DIRECT | psw;
+    state->flagAux = psw;
+#else
+    state->cc.z = (0 != (psw & ZERO_MASK));
+    state->cc.s = (0 != (psw & SIGN_MASK));
+    state->cc.p = (0 != (psw & PARITY_MASK));
+    state->cc.ac = (0 != (psw & AC_MASK));
+#endif
+    SET_C(state, (0 != (psw & CARRY_MASK)));
+    state->sp += 2;
+}
+
+static inline void CORE_FN(pushPSW) (i8080* state) {
+    CORE_WRITE(state, (uint16_t)(state->sp-1), state->a);
+    uint8_t psw = (FLAG_C(state) ? CARRY_MASK : 0) |
+                  (FLAG_P(state) ? PARITY_MASK : 0) |
+                  (FLAG_AC(state) ? AC_MASK : 0) |
+                  (FLAG_Z(state) ? ZERO_MASK : 0) |
+                  (FLAG_S(state) ? SIGN_MASK : 0) | 0x02;
+    CORE_WRITE(state, (uint16_t)(state->sp-2), psw);
+    state->sp = state->sp - 2;
+}
+
+static inline void CORE_FN(stax) (i8080* state, uint16_t addr) {
+    CORE_WRITE(state, addr, state->a);
+}
+
+static inline void CORE_FN(shld) (i8080* state, uint16_t value) {
+    CORE_WRITE(state, value, state->l);
+    CORE_WRITE(state, (uint16_t)(value+1), state->h);
+}
+
+static inline void CORE_FN(sta) (i8080* state, uint16_t value) {
+    CORE_WRITE(state, value, state->a);
+}
+
+static inline void CORE_FN(ldax) (i8080* state, uint16_t addr) {
+    state->a = CORE_READ(state, addr);
+}
+
+static inline void CORE_FN(lhld) (i8080* state, uint16_t value) {
+    state->l = CORE_READ(state, value);
+    state->h = CORE_READ(state, (uint16_t)(value+1));
+}
+
+static inline void CORE_FN(lda) (i8080* state, uint16_t value) {
+    state->a = CORE_READ(state, value);
+}
+
+// pc is advanced past the instruction before it executes, branches overwrite it
+// returns the instruction's FLOW_ class, non-zero when it ends a basic block,
+// or FLOW_TRAP when a memory hook asked to stop
+CORE_LINKAGE int CORE_STEP (i8080* state) {
+    CORE_TRACE(state);
+    uint16_t pc = state->pc;
+    unsigned char* opcode = &state->memory[pc];
+    const OpcodeInfo* info = &opcodeTable[*opcode];
+    uint16_t address = state->hl;
+    uint16_t temp = 0;
+    uint8_t m = 0;
+    state->pc += info->length;
+    CORE_CYCLES(state, info->cycles);
+    switch (*opcode) {
+    case (0x00):    // NOP
+        break;
+    case (0x01):    // LXI B, d16
+        lxi (&state->bc, getNextWord(state, pc));
+        break;
+    case (0x02):    // STAX B
+        stax(state, state->bc);
+        break;
+    case (0x03):    // INX B
+        inx(&state->bc);
+        break;
+    case (0x04):    // INR B (S, Z, A, P)
+        inr(state, &state->b);
+        break;
+    case (0x05):    // DCR B
+        dcr(state, &state->b);
+        break;
+    case (0x06):    // MVI B, d8
+        mvi (&state->b, getNextByte(state, pc));
+        break;
+    case (0x07):    // RLC
+        rlc(state);
+        break;
+    case (0x08):    // NOP
+        break;
+    case (0x09):    // DAD B
+        dad(state, state->bc);
+        break;
+    case (0x0A):    // LDAC B
+        ldax(state, state->bc);
+        break;
+    case (0x0B):    // DCX B
+        dcx(&state->bc);
+        break;
+    case (0x0C):    // INR C (S, Z, A, P)
+        inr(state, &state->c);
+        break;
+    case (0x0D):    // DCR C
+        dcr(state, &state->c);
+        break;
+    case (0x0E):    // MVI C, d8
+        mvi(&state->c, getNextByte(state, pc));
+        break;
+    case (0x0F):    // RRC
+        rrc(state);
+        break;
+    case (0x10):    // NOP
+        break;
+    case (0x11):    // LXI D, d16
+        lxi (&state->de, getNextWord(state, pc));
+        break;
+    case (0x12):    // STAX D
+        stax(state, state->de);
+        break;
+    case (0x13):    // INX D
+        inx(&state->de);
+        break;
+    case (0x14):    // INR D (S, Z, A, P)
+        inr(state, &state->d);
+        break;
+    case (0x15):    // DCR D
+        dcr(state, &state->d);
+        break;
+    case (0x16):    // MVI D, d8
+        mvi(&state->d, getNextByte(state, pc));
+        break;
+    case (0x17):    // RAL
+        ral(state);
+        break;
+    case (0x18):    // NOP
+        break;
+    case (0x19):    // DAD D
+        dad(state, state->de);
+        break;
+    case (0x1A):    // LDAC D
+        ldax(state, state->de);
+        break;
+    case (0x1B):    // DCX D
+        dcx(&state->de);
+        break;
+    case (0x1C):    // INR E (S, Z, A, P)
+        inr(state, &state->e);
+        break;
+    case (0x1D):    // DCR E
+        dcr(state, &state->e);
+        break;
+    case (0x1E):    // MVI E, d8
+        mvi(&state->e, getNextByte(state, pc));
+        break;
+    case (0x1F):    // RAR
+        rar(state);
+        break;
+    case (0x20):    // RIM MIYA
+        break;
+    case (0x21):    // LXI H, d16
+        lxi (&state->hl, getNextWord(state, pc));
+        break;
+    case (0x22):    // SHLD addr
+        shld(state, getNextWord(state, pc));
+        break;
+    case (0x23):    // INX H
+        inx(&state->hl);
+        break;
+    case (0x24):    // INR H (S, Z, A, P)
+        inr(state, &state->h);
+        break;
+    case (0x25):    // DCR H
+        dcr(state, &state->h);
+        break;
+    case (0x26):    // MVI H, d8
+        mvi(&state->h, getNextByte(state, pc));
+        break;
+    case (0x27):    // DAA
+        daa(state);
+        break;
+    case (0x28):    // NOP
+        break;
+    case (0x29):    // DAD H
+        dad(state, state->hl);
+        break;
+    case (0x2A):    // LHLD addr
+        lhld(state, getNextWord(state, pc));
+        break;
+    case (0x2B):    // DCX H
+        dcx(&state->hl);
+        break;
+    case (0x2C):    // INR L (S, Z, A, P)
+        inr(state, &state->l);
+        break;
+    case (0x2D):    // DCR L
+        dcr(state, &state->l);
+        break;
+    case (0x2E):    // MVI L, d8
+        mvi(&state->l, getNextByte(state, pc));
+        break;
+    case (0x2F):    // CMA
+        state->a = ~state->a;
+        break;
+    case (0x30):    // SIM MIYA
+        break;
+    case (0x31):    // LXI SP, d16
+        state->sp = getNextWord(state, pc);
+        break;
+    case (0x32):    // STA addr
+        sta(state, getNextWord(state, pc));
+        break;
+    case (0x33):    // INX SP
+        state->sp += 1;
+        break;
+    case (0x34):    // INR M (S, Z, A, P)
+        m = CORE_READ(state, address);
+        inr(state, &m);
+        CORE_WRITE(state, address, m);
+        break;
+    case (0x35):    // DCR M
+        m = CORE_READ(state, address);
+        dcr(state, &m);
+        CORE_WRITE(state, address, m);
+        break;
+    case (0x36):    // MVI M, d8
+        CORE_WRITE(state, address, getNextByte(state, pc));
+        break;
+    case (0x37):    // STC
+        SET_C(state, 1);
+        break;
+    case (0x38):    // NOP
+        break;
+    case (0x39):    // DAD SP
+        dad(state, state->sp);
+        break;
+    case (0x3A):    // LDA addr
+        lda(state, getNextWord(state, pc));
+        break;
+    case (0x3B):    // DCX SP MIYA
+        state->sp -= 1;
+        break;
+    case (0x3C):    // INR A (S, Z, A, P)
+        inr(state, &state->a);
+        break;
+    case (0x3D):    // DCR A
+        dcr(state, &state->a);
+        break;
+    case (0x3E):    // MVI A, d8
+        mvi(&state->a, getNextByte(state, pc));
+        break;
+    case (0x3F):    // CMC
+        SET_C(state, !FLAG_C(state));
+        break;
+    case (0x40):    // MOV B, B
+        mov(&state->b, state->b);
+        break;
+    case (0x41):    // MOV B, C
+        mov(&state->b, state->c);
+        break;
+    case (0x42):    // MOV B, D
+        mov(&state->b, state->d);
+        break;
+    case (0x43):    // MOV B, E
+        mov(&state->b, state->e);
+        break;
+    case (0x44):    // MOV B, H
+        mov(&state->b, state->h);
+        break;
+    case (0x45):    // MOV B, L
+        mov(&state->b, state->l);
+        break;
+    case (0x46):    // MOV B, M
+        mov(&state->b, CORE_READ(state, address));
+        break;
+    case (0x47):    // MOV B, A
+        mov(&state->b, state->a);
+        break;
+    case (0x48):    // MOV C, B
+        mov(&state->c, state->b);
+        break;
+    case (0x49):    // MOV C, C
+        mov(&state->c, state->c);
+        break;
+    case (0x4A):    // MOV C, D
+        mov(&state->c, state->d);
+        break;
+    case (0x4B):    // MOV C, E
+        mov(&state->c, state->e);
+        break;
+    case (0x4C):    // MOV C, H
+        mov(&state->c, state->h);
+        break;
+    case (0x4D):    // MOV C, L
+        mov(&state->c, state->l);
+        break;
+    case (0x4E):    // MOV C, M
+        mov(&state->c, CORE_READ(state, address));
+        break;
+    case (0x4F):    // MOV C, A
+        mov(&state->c, state->a);
+        break;
+    case (0x50):    // MOV D, B
+        mov(&state->d, state->b);
+        break;
+    case (0x51):    // MOV D, C
+        mov(&state->d, state->c);
+        break;
+    case (0x52):    // MOV D, D
+        mov(&state->d, state->d);
+        break;
+    case (0x53):    // MOV D, E
+        mov(&state->d, state->e);
+        break;
+    case (0x54):    // MOV D, H
+        mov(&state->d, state->h);
+        break;
+    case (0x55):    // MOV D, L
+        mov(&state->d, state->l);
+        break;
+    case (0x56):    // MOV D, M
+        mov(&state->d, CORE_READ(state, address));
+        break;
+    case (0x57):    // MOV D, A
+        mov(&state->d, state->a);
+        break;
+    case (0x58):    // MOV E, B
+        mov(&state->e, state->b);
+        break;
+    case (0x59):    // MOV E, C
+        mov(&state->e, state->c);
+        break;
+    case (0x5A):    // MOV E, D
+        mov(&state->e, state->d);
+        break;
+    case (0x5B):    // MOV E, E
+        mov(&state->e, state->e);
+        break;
+    case (0x5C):    // MOV E, H
+        mov(&state->e, state->h);
+        break;
+    case (0x5D):    // MOV E, L
+        mov(&state->e, state->l);
+        break;
+    case (0x5E):    // MOV E, M
+        mov(&state->e, CORE_READ(state, address));
+        break;
+    case (0x5F):    // MOV E, A
+        mov(&state->e, state->a);
+        break;
+    case (0x60):    // MOV H, B
+        mov(&state->h, state->b);
+        break;
+    case (0x61):    // MOV H, C
+        mov(&state->h, state->c);
+        break;
+    case (0x62):    // MOV H, D
+        mov(&state->h, state->d);
+        break;
+    case (0x63):    // MOV H, E
+        mov(&state->h, state->e);
+        break;
+    case (0x64):    // MOV H, H
+        mov(&state->h, state->h);
+        break;
+    case (0x65):    // MOV H, L
+        mov(&state->h, state->l);
+        break;
+    case (0x66):    // MOV H, M
+        mov(&state->h, CORE_READ(state, address));
+        break;
+    case (0x67):    // MOV H, A
+        mov(&state->h, state->a);
+        break;
+    case (0x68):    // MOV L, B
+        mov(&state->l, state->b);
+        break;
+    case (0x69):    // MOV L, C
+        mov(&state->l, state->c);
+        break;
+    case (0x6A):    // MOV L, D
+        mov(&state->l, state->d);
+        break;
+    case (0x6B):    // MOV L, E
+        mov(&state->l, state->e);
+        break;
+    case (0x6C):    // MOV L, H
+        mov(&state->l, state->h);
+        break;
+    case (0x6D):    // MOV L, L
+        mov(&state->l, state->l);
+        break;
+    case (0x6E):    // MOV L, M
+        mov(&state->l, CORE_READ(state, address));
+        break;
+    case (0x6F):    // MOV L, A
+        mov(&state->l, state->a);
+        break;
+    case (0x70):    // MOV M, B
+        CORE_WRITE(state, address, state->b);
+        break;
+    case (0x71):    // MOV M, C
+        CORE_WRITE(state, address, state->c);
+        break;
+    case (0x72):    // MOV M, D
+        CORE_WRITE(state, address, state->d);
+        break;
+    case (0x73):    // MOV M, E
+        CORE_WRITE(state, address, state->e);
+        break;
+    case (0x74):    // MOV M, H
+        CORE_WRITE(state, address, state->h);
+        break;
+    case (0x75):    // MOV M, L
+        CORE_WRITE(state, address, state->l);
+        break;
+    case (0x76):    // HLT
+        state->halt = 1;
+        break;
+    case (0x77):    // MOV M, A
+        CORE_WRITE(state, address, state->a);
+        break;
+    case (0x78):    // MOV A, B
+        state->a = state->b;
+        break;
+    case (0x79):    // MOV A, C
+        state->a = state->c;
+        break;
+    case (0x7A):    // MOV A, D
+        state->a = state->d;
+        break;
+    case (0x7B):    // MOV A, E
+        state->a = state->e;
+        break;
+    case (0x7C):    // MOV A, H
+        state->a = state->h;
+        break;
+    case (0x7D):    // MOV A, L
+        state->a = state->l;
+        break;
+    case (0x7E):    // MOV A, M
+        state->a = CORE_READ(state, address);
+        break;
+    case (0x7F):    // MOV A, A
+        state->a = state->a;
+        break;
+    case (0x80):    // ADD B
+        add(state, state->b);
+        break;
+    case (0x81):    // ADD C
+        add(state, state->c);
+        break;
+    case (0x82):    // ADD D
+        add(state, state->d);
+        break;
+    case (0x83):    // ADD E
+        add(state, state->e);
+        break;
+    case (0x84):    // ADD H
+        add(state, state->h);
+        break;
+    case (0x85):    // ADD L
+        add(state, state->l);
+        break;
+    case (0x86):    // ADD M
+        add(state, CORE_READ(state, address));
+        break;
+    case (0x87):    // ADD A
+        add(state, state->a);
+        break;
+    case (0x88):    // ADC B
+        addC(state, state->b);
+        break;
+    case (0x89):    // ADC C
+        addC(state, state->c);
+        break;
+    case (0x8A):    // ADC D
+        addC(state, state->d);
+        break;
+    case (0x8B):    // ADC E
+        addC(state, state->e);
+        break;
+    case (0x8C):    // ADC H
+        addC(state, state->h);
+        break;
+    case (0x8D):    // ADC L
+        addC(state, state->l);
+        break;
+    case (0x8E):    // ADC M
+        addC(state, CORE_READ(state, address));
+        break;
+    case (0x8F):    // ADC A
+        addC(state, state->a);
+        break;
+    case (0x90):    // SUB B
+        sub(state, state->b);
+        break;
+    case (0x91):    // SUB C
+        sub(state, state->c);
+        break;
+    case (0x92):    // SUB D
+        sub(state, state->d);
+        break;
+    case (0x93):    // SUB E
+        sub(state, state->e);
+        break;
+    case (0x94):    // SUB H
+        sub(state, state->h);
+        break;
+    case (0x95):    // SUB L
+        sub(state, state->l);
+        break;
+    case (0x96):    // SUB M
+        sub(state, CORE_READ(state, address));
+        break;
+    case (0x97):    // SUB A
+        sub(state, state->a);
+        break;
+    case (0x98):    // SBB B
+        subC(state, state->b);
+        break;
+    case (0x99):    // SBB C
+        subC(state, state->c);
+        break;
+    case (0x9A):    // SBB D
+        subC(state, state->d);
+        break;
+    case (0x9B):    // SBB E
+        subC(state, state->e);
+        break;
+    case (0x9C):    // SBB H
+        subC(state, state->h);
+        break;
+    case (0x9D):    // SBB L
+        subC(state, state->l);
+        break;
+    case (0x9E):    // SBB M
+        subC(state, CORE_READ(state, address));
+        break;
+    case (0x9F):    // SBB A
+        subC(state, state->a);
+        break;
+    case (0xA0):    // ANA B
+        ana(state, state->b);
+        break;
+    case (0xA1):    // ANA C
+        ana(state, state->c);
+        break;
+    case (0xA2):    // ANA D
+        ana(state, state->d);
+        break;
+    case (0xA3):    // ANA E
+        ana(state, state->e);
+        break;
+    case (0xA4):    // ANA H
+        ana(state, state->h);
+        break;
+    case (0xA5):    // ANA L
+        ana(state, state->l);
+        break;
+    case (0xA6):    // ANA M
+        ana(state, CORE_READ(state, address));
+        break;
+    case (0xA7):    // ANA A
+        ana(state, state->a);
+        break;
+    case (0xA8):    // XRA B
+        xra(state, state->b);
+        break;
+    case (0xA9):    // XRA C
+        xra(state, state->c);
+        break;
+    case (0xAA):    // XRA D
+        xra(state, state->d);
+        break;
+    case (0xAB):    // XRA E
+        xra(state, state->e);
+        break;
+    case (0xAC):    // XRA H
+        xra(state, state->h);
+        break;
+    case (0xAD):    // XRA L
+        xra(state, state->l);
+        break;
+    case (0xAE):    // XRA M
+        xra(state, CORE_READ(state, address));
+        break;
+    case (0xAF):    // XRA A
+        xra(state, state->a);
+        break;
+    case (0xB0):    // ORA B
+        ora(state, state->b);
+        break;
+    case (0xB1):    // OR
+        ora(state, state->c);
+        break;
+    case (0xB2):    // ORA D
+        ora(state, state->d);
+        break;
+    case (0xB3):    // ORA E
+        ora(state, state->e);
+        break;
+    case (0xB4):    // ORA H
+        ora(state, state->h);
+        break;
+    case (0xB5):    // ORA L
+        ora(state, state->l);
+        break;
+    case (0xB6):    // ORA M
+        ora(state, CORE_READ(state, address));
+        break;
+    case (0xB7):    // ORA A
+        ora(state, state->a);
+        break;
+    case (0xB8):    // CMP B
+        cmp(state, state->b);
+        break;
+    case (0xB9):    // CMP C
+        cmp(state, state->c);
+        break;
+    case (0xBA):    // CMP D
+        cmp(state, state->d);
+        break;
+    case (0xBB):    // CMP E
+        cmp(state, state->e);
+        break;
+    case (0xBC):    // CMP H
+        cmp(state, state->h);
+        break;
+    case (0xBD):    // CMP L
+        cmp(state, state->l);
+        break;
+    case (0xBE):    // CMP M
+        cmp(state, CORE_READ(state, address));
+        break;
+    case (0xBF):    // CMP A
+        cmp(state, state->a);
+        break;
+    case (0xC0):    // RNZ
+        rnx(state, FLAG_Z(state), opcode);
+        break;
+    case (0xC1):    // POP B
+        pop(state, &state->bc);
+        break;
+    case (0xC2):    // JNZ addr
+        jnx(state, FLAG_Z(state), getNextWord(state, pc));
+        break;
+    case (0xC3):    // JMP addr
+        state->pc = getNextWord(state, pc);
+        break;
+    case (0xC4):    // CNZ addr
+        cnx(state, FLAG_Z(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xC5):    // PUSH B
+        push(state, state->bc);
+        break;
+    case (0xC6):    // ADI d8
+        add(state, (uint16_t)getNextByte(state, pc));
+        break;
+    case (0xC7):    // RST 0
+        rst(state, 0x0000);
+        break;
+    case (0xC8):    // RZ
+        rx(state, FLAG_Z(state), opcode);
+        break;
+    case (0xC9):    // RET
+        ret(state);
+        break;
+    case (0xCA):    // JZ addr
+        jx(state, FLAG_Z(state), getNextWord(state, pc));
+        break;
+    case (0xCB):    // JMP addr
+        state->pc = getNextWord(state, pc);
+        break;
+    case (0xCC):    // CZ addr
+        cx(state, FLAG_Z(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xCD):    // CALL addr
+        call (state, getNextWord(state, pc));
+        break;
+    case (0xCE):    // ACI d8
+        addC(state, getNextByte(state, pc));
+        break;
+    case (0xCF):    // RST 1
+        rst(state, 0x0008);
+        break;
+    case (0xD0):    // RNC
+        rnx(state, FLAG_C(state), opcode);
+        break;
+    case (0xD1):    // POP D
+        pop(state, &state->de);
+        break;
+    case (0xD2):    // JNC addr
+        jnx (state, FLAG_C(state), getNextWord(state, pc));
+        break;
+    case (0xD3):    // OUT d8
+        CORE_OUT(state, getNextByte(state, pc), state->a);
+        break;
+    case (0xD4):    // CNC addr
+        cnx(state, FLAG_C(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xD5):    // PUSH D
+        push(state, state->de);
+        break;
+    case (0xD6):    // SUI d8
+        sub(state, getNextByte(state, pc));
+        break;
+    case (0xD7):    // RST 2
+        rst(state, 0x0010);
+        break;
+    case (0xD8):    // RC
+        rx(state, FLAG_C(state), opcode);
+        break;
+    case (0xD9):    // RET (alias)
+        ret(state);
+        break;
+    case (0xDA):    // JC addr
+        jx(state, FLAG_C(state), getNextWord(state, pc));
+        break;
+    case (0xDB):    // IN d8
+        state->a = CORE_IN(state, getNextByte(state, pc));
+        break;
+    case (0xDC):    // CC addr
+        cx(state, FLAG_C(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xDD):    // CALL addr (alias)
+        call (state, getNextWord(state, pc));
+        break;
+    case (0xDE):    // SBI d8
+        subC(state, getNextByte(state, pc));
+        break;
+    case (0xDF):    // RST 3
+        rst(state, 0x0018);
+        break;
+    case (0xE0):    // RPO
+        rnx(state, FLAG_P(state), opcode);
+        break;
+    case (0xE1):    // POP H
+        pop(state, &state->hl);
+        break;
+    case (0xE2):    // JPO addr
+        jnx(state, FLAG_P(state), getNextWord(state, pc));
+        break;
+    case (0xE3):    // XTHL
+        temp = (CORE_READ(state, (uint16_t)(state->sp+1))<<8) | CORE_READ(state, state->sp);
+        CORE_WRITE(state, state->sp, state->l);
+        CORE_WRITE(state, (uint16_t)(state->sp+1), state->h);
+        state->hl = temp;
+        break;
+    case (0xE4):    // CPO addr
+        cnx(state, FLAG_P(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xE5):    // PUSH H
+        push(state, state->hl);
+        break;
+    case (0xE6):    // ANI d8
+        anaI(state, getNextByte(state, pc));
+        break;
+    case (0xE7):    // RST 4
+        rst(state, 0x0020);
+        break;
+    case (0xE8):    // RPE
+        rx(state, FLAG_P(state), opcode);
+        break;
+    case (0xE9):    // PCHL
+        state->pc = state->hl;
+        break;
+    case (0xEA):    // JPE addr
+        jx(state, FLAG_P(state), getNextWord(state, pc));
+        break;
+    case (0xEB):    // XCHG
+        temp = state->de;
+        state->de = state->hl;
+        state->hl = temp;
+        break;
+    case (0xEC):    // CPE addr
+        cx(state, FLAG_P(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xED):    // CALL addr (alias)
+        call (state, getNextWord(state, pc));
+        break;
+    case (0xEE):    // XRI d8
+        xra(state, getNextByte(state, pc));
+        break;
+    case (0xEF):    // RST 5
+        rst(state, 0x0028);
+        break;
+    case (0xF0):    // RP
+        rnx(state, FLAG_S(state), opcode);
+        break;
+    case (0xF1):    // POP PSW
+        popPSW(state);
+        break;
+    case (0xF2):    // JP addr
+        jnx (state, FLAG_S(state), getNextWord(state, pc));
+        break;
+    case (0xF3):    // DI
+        state->IE = 0;
+        break;
+    case (0xF4):    // CP addr
+        cnx(state, FLAG_S(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xF5):    // PUSH PSW
+        pushPSW(state);
+        break;
+    case (0xF6):    // ORI d8
+        ora(state, getNextByte(state, pc));
+        break;
+    case (0xF7):    // RST 6
+        rst(state, 0x0030);
+        break;
+    case (0xF8):    // RM
+        rx(state, FLAG_S(state), opcode);
+        break;
+    case (0xF9):    // SPHL
+        state->sp = state->hl;
+        break;
+    case (0xFA):    // JM addr
+        jx(state, FLAG_S(state), getNextWord(state, pc));
+        break;
+    case (0xFB):    // EI
+        state->IE = 1;
+        break;
+    case (0xFC):    // CM addr
+        cx(state, FLAG_S(state), opcode, getNextWord(state, pc));
+        break;
+    case (0xFD):    // CALL addr (alias)
+        call (state, getNextWord(state, pc));
+        break;
+    case (0xFE):    // CPI d8
+        cmp(state, getNextByte(state, pc));
+        break;
+    case (0xFF):    // RST 7
+        rst(state, 0x0038);
+        break;
+    }
+    return CORE_TRAP(state) ? FLOW_TRAP : info->flow;
+}
+
+#ifndef CORE_KEEP_NAMES
+#undef dad
+#undef rlc
+#undef ral
+#undef rrc
+#undef rar
+#undef arithmeticAll
+#undef add
+#undef addC
+#undef sub
+#undef subC
+#undef inr
+#undef dcr
+#undef daa
+#undef ana
+#undef anaI
+#undef ora
+#undef xra
+#undef cmp
+#undef call
+#undef ret
+#undef cnx
+#undef cx
+#undef rnx
+#undef rx
+#undef rst
+#undef pop
+#undef push
+#undef popPSW
+#undef pushPSW
+#undef stax
+#undef shld
+#undef sta
+#undef ldax
+#undef lhld
+#undef lda
+#undef FLAG_C
+#undef FLAG_Z
+#undef FLAG_S
+#undef FLAG_P
+#undef FLAG_AC
+#undef SET_C
+#undef SET_SZP
+#undef SET_AC
+#undef SET_AC_ADD
+#undef SET_AC_SUB
+#undef CORE_STEP
+#undef CORE_LINKAGE
+#undef CORE_READ
+#undef CORE_WRITE
+#undef CORE_TRAP
+#undef CORE_IN
+#undef CORE_OUT
+#undef CORE_TRACE
+#undef CORE_CYCLES
+#undef CORE_SHADOW_CALL
+#undef CORE_SHADOW_RET
+#undef CORE_SPLIT_FLAGS
+#endif
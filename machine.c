@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#ifdef I8080_AOT
+#include "aot.h"
+#endif
+
+static uint8_t machineIn (i8080* state, uint8_t port) {
+    Machine* machine = state->ioContext;
+    switch (port) {
+        case 0:
+        case 1:
+        case 2:
+            return machine->inputs[port];
+        case 3:     // shift register result
+            return (machine->shift >> (8 - machine->shiftOffset)) & 0xff;
+        default:
+            return 0;
+    }
+}
+
+static void machineOut (i8080* state, uint8_t port, uint8_t value) {
+    Machine* machine = state->ioContext;
+    switch (port) {
+        case 2:
+            machine->shiftOffset = value & 7;
+            break;
+        case 3:
+            machine->sound[0] = value;
+            break;
+        case 4:
+            machine->shift = (value << 8) | (machine->shift >> 8);
+            break;
+        case 5:
+            machine->sound[1] = value;
+            break;
+        default:    // 6 is the watchdog
+            break;
+    }
+}
+
+// rom decodes in fusion[] and the recompiled rom are only good while the
+// bytes under them are; the game never stores below ROM_SIZE, but if
+// anything does they are dropped
+static void machineForget (Machine* machine) {
+    memset(machine->fusion, 0, sizeof(machine->fusion));
+    machine->aot = false;
+}
+
+static inline void machineWrite (i8080* state, uint16_t address, uint8_t value) {
+    if (address < ROM_SIZE) {
+        machineForget(state->ioContext);
+    }
+    state->memory[address] = value;
+}
+
+// the board's own core: ram and rom are plain memory, the ports above are
+// called directly and flags are split. no hooks or shadow stack, so it must not run
+// while a debugger, watchpoints or the sampler are installed; main falls back to
+// opcodeExtract then
+#define CORE_STEP machineStep
+#define CORE_READ(state, address) ((state)->memory[address])
+#define CORE_WRITE(state, address, value) machineWrite(state, address, value)
+#define CORE_TRAP(state) 0
+#define CORE_IN(state, port) machineIn(state, port)
+#define CORE_OUT(state, port, value) machineOut(state, port, value)
+#define CORE_SHADOW_CALL(state, entry, ret)
+#define CORE_SHADOW_RET(state, ret)
+#define CORE_SPLIT_FLAGS
+#include "i8080core.h"
+
+// superinstructions: the sequences that dominate attract mode and play,
+// going by pair counts over the rom, each run by one handler below. a
+// rom address is decoded the first time a block reaches it and keeps its
+// FUSE_ kind in machine->fusion. handlers do exactly what the instructions
+// would one by one, flags and cycles included; the sequences end at a
+// branch or inside a block, and interrupts are only taken between blocks,
+// so interrupt timing is unchanged
+enum {
+    FUSE_UNDECODED,
+    FUSE_NONE,
+    FUSE_LDA_ANA_JNZ,       // wait for a flag to clear
+    FUSE_LDA_ANA_JZ,        // wait for a flag to be set
+    FUSE_LDA_DCR_JNZ,       // wait for a counter to reach one
+    FUSE_MOV_ANA_JNZ,       // scan a table for a non-zero byte
+    FUSE_INX_DCR_JNZ,       // and step to its next entry
+    FUSE_COPY,              // LDAX D; MOV M,A; INX H; INX D; DCR B; JNZ
+    FUSE_DCR_JNZ,           // any other DCR B loop
+    FUSE_COUNT
+};
+
+typedef struct {
+    uint8_t count;
+    uint8_t cycles;         // sum of the opcodeTable cycles
+    uint8_t opcodes[6];
+} FusedPattern;
+
+static const FusedPattern fusedPatterns[FUSE_COUNT] = {
+    [FUSE_LDA_ANA_JNZ] = { 3, 27, { 0x3A, 0xA7, 0xC2 } },
+    [FUSE_LDA_ANA_JZ] = { 3, 27, { 0x3A, 0xA7, 0xCA } },
+    [FUSE_LDA_DCR_JNZ] = { 3, 28, { 0x3A, 0x3D, 0xC2 } },
+    [FUSE_MOV_ANA_JNZ] = { 3, 21, { 0x7E, 0xA7, 0xC2 } },
+    [FUSE_INX_DCR_JNZ] = { 3, 20, { 0x23, 0x05, 0xC2 } },
+    [FUSE_COPY] = { 6, 39, { 0x1A, 0x77, 0x23, 0x13, 0x05, 0xC2 } },
+    [FUSE_DCR_JNZ] = { 2, 15, { 0x05, 0xC2 } },
+};
+
+// first pattern that matches at pc and lies wholly in rom, FUSE_NONE if none
+static uint8_t fuseDecode (const uint8_t* memory, uint16_t pc) {
+    for (int kind = FUSE_NONE + 1; kind < FUSE_COUNT; kind++) {
+        const FusedPattern* pattern = &fusedPatterns[kind];
+        uint32_t at = pc;
+        int i;
+        for (i = 0; i < pattern->count && at < ROM_SIZE && memory[at] == pattern->opcodes[i]; i++) {
+            at += opcodeTable[memory[at]].length;
+        }
+        if (i == pattern->count && at <= ROM_SIZE) {
+            return kind;
+        }
+    }
+    return FUSE_NONE;
+}
+
+// runs the sequence at pc, returns the FLOW_ class of its last instruction.
+// the flag work goes through the board core's own helpers (machineStep_ana
+// and so on), so the split flags end up as the core would leave them
+static inline int machineFused (i8080* state, int kind, uint16_t pc) {
+    uint8_t* memory = state->memory;
+    state->cycles += fusedPatterns[kind].cycles;
+    switch (kind) {
+        case FUSE_LDA_ANA_JNZ:
+            state->a = memory[getNextWord(state, pc)];
+            machineStep_ana(state, state->a);
+            state->pc = state->a ? getNextWord(state, pc + 4) : pc + 7;
+            return FLOW_JUMP_COND;
+        case FUSE_LDA_ANA_JZ:
+            state->a = memory[getNextWord(state, pc)];
+            machineStep_ana(state, state->a);
+            state->pc = state->a ? pc + 7 : getNextWord(state, pc + 4);
+            return FLOW_JUMP_COND;
+        case FUSE_LDA_DCR_JNZ:
+            state->a = memory[getNextWord(state, pc)];
+            machineStep_dcr(state, &state->a);
+            state->pc = state->a ? getNextWord(state, pc + 4) : pc + 7;
+            return FLOW_JUMP_COND;
+        case FUSE_MOV_ANA_JNZ:
+            state->a = memory[state->hl];
+            machineStep_ana(state, state->a);
+            state->pc = state->a ? getNextWord(state, pc + 2) : pc + 5;
+            return FLOW_JUMP_COND;
+        case FUSE_INX_DCR_JNZ:
+            state->hl++;
+            machineStep_dcr(state, &state->b);
+            state->pc = state->b ? getNextWord(state, pc + 2) : pc + 5;
+            return FLOW_JUMP_COND;
+        case FUSE_COPY:
+            if (state->hl < ROM_SIZE) {     // the store could rewrite the sequence itself
+                state->cycles -= fusedPatterns[kind].cycles;
+                return machineStep(state);
+            }
+            state->a = memory[state->de];
+            memory[state->hl] = state->a;
+            state->hl++;
+            state->de++;
+            machineStep_dcr(state, &state->b);
+            state->pc = state->b ? getNextWord(state, pc + 5) : pc + 8;
+            return FLOW_JUMP_COND;
+        default:    // FUSE_DCR_JNZ
+            machineStep_dcr(state, &state->b);
+            state->pc = state->b ? getNextWord(state, pc + 1) : pc + 4;
+            return FLOW_JUMP_COND;
+    }
+}
+
+static inline int machineFusedStep (Machine* machine, i8080* state) {
+    uint16_t pc = state->pc;
+    if (pc >= ROM_SIZE) {
+        return machineStep(state);
+    }
+    uint8_t kind = machine->fusion[pc];
+    if (kind == FUSE_UNDECODED) {
+        kind = machine->fusion[pc] = fuseDecode(state->memory, pc);
+    }
+    if (kind == FUSE_NONE) {
+        return machineStep(state);
+    }
+    return machineFused(state, kind, pc);
+}
+
+static uint64_t packRegisters (i8080* state) {
+    syncSplitFlags(state);
+    uint8_t flags = state->cc.z | state->cc.s << 1 | state->cc.p << 2 | state->cc.c << 3 | state->cc.ac << 4;
+    return (uint64_t) state->a | (uint64_t) state->bc << 8 | (uint64_t) state->de << 24 |
+           (uint64_t) state->hl << 40 | (uint64_t) flags << 56;
+}
+
+// true when no instruction of the block at start can store, touch a port or
+// change the interrupt enable, going by opcodeTable
+static bool idleBody (const i8080* state, uint16_t start) {
+    uint16_t pc = start;
+    for (int i = 0; i < IDLE_MAX_INSTRUCTIONS; i++) {
+        const OpcodeInfo* info = &opcodeTable[state->memory[pc]];
+        if (info->effects) {
+            return false;
+        }
+        if (info->flow != FLOW_NONE) {
+            return true;
+        }
+        pc += info->length;
+    }
+    return false;
+}
+
+// called after a block that jumped back to its own start. if the previous
+// block was this one too, ended with the same registers and flags, and the
+// body has no side effects, then memory is unchanged and every further pass
+// is identical until the next interrupt: skip the passes before it whole, so
+// the cycle count is what interpreting them would give
+static void machineIdle (Machine* machine, i8080* state, uint16_t start) {
+    uint64_t registers = packRegisters(state);
+    if (machine->idleStart == start && machine->idleRegisters == registers &&
+        machine->idleSp == state->sp && state->cycles < machine->interruptAt && idleBody(state, start)) {
+        uint64_t pass = state->cycles - machine->idleCycles;
+        uint64_t skipped = (machine->interruptAt - state->cycles + pass - 1) / pass * pass;
+        state->cycles += skipped;
+        machine->idleSkipped += skipped;
+    }
+    machine->idleStart = start;
+    machine->idleRegisters = registers;
+    machine->idleSp = state->sp;
+    machine->idleCycles = state->cycles;
+}
+
+// HLT parks the cpu until the next interrupt, so time jumps straight to it
+// with nothing interpreted. false when interrupts are disabled: then nothing
+// can wake it and the run is over
+bool machineHalt (Machine* machine, i8080* state) {
+    if (!state->IE) {
+        return false;
+    }
+    if (state->cycles < machine->interruptAt) {
+        machine->idleSkipped += machine->interruptAt - state->cycles;
+        state->cycles = machine->interruptAt;
+    }
+    return true;
+}
+
+// runs to the end of the current basic block, returns its FLOW_ class. in
+// builds with the recompiled rom (aot.h) the compiled block runs when there
+// is one, and with it every compiled block it chains to before the next
+// interrupt is due; start is then the last of them
+int machineRunBlock (Machine* machine, i8080* state) {
+    uint16_t start = state->pc;
+    int flow = FLOW_NONE;
+#ifdef I8080_AOT
+    if (machine->aot) {
+        flow = aotRunBlock(state, &machine->aotCache, machine->interruptAt, &start);
+        if (state->trap) {
+            state->trap = false;
+            machineForget(machine);
+        }
+    }
+#endif
+    // all of the block, or what the recompiled code left of it
+    if (machine->fuse) {
+        while (!flow) {
+            flow = machineFusedStep(machine, state);
+        }
+    }
+    while (!flow) {
+        flow = machineStep(state);
+    }
+    if (state->pc == start && machine->idleSkip) {
+        machineIdle(machine, state, start);
+    }
+    else {
+        machine->idleStart = -1;
+    }
+    return flow;
+}
+
+void machineInit (Machine* machine, i8080* state) {
+    memset(machine, 0, sizeof(*machine));
+    machine->inputs[0] = 0x0E;
+    machine->inputs[1] = 0x08;      // bit 3 always reads 1
+    machine->nextInterrupt = 1;
+    machine->interruptAt = state->cycles + CYCLES_PER_FRAME / 2;
+    machine->idleSkip = true;
+    machine->idleStart = -1;
+    machine->fuse = true;
+    machine->aot = true;
+    state->portIn = machineIn;
+    state->portOut = machineOut;
+    state->ioContext = machine;
+}
+
+void machineInterrupt (Machine* machine, i8080* state) {
+    if (generateInterrupt(state, machine->nextInterrupt)) {
+#ifdef I8080_AOT
+        aotPush(&machine->aotCache, 0);     // popped by the handler's RET, not the interrupted code's site
+#endif
+        if (state->sp < ROM_SIZE) {     // pushed over rom, see machineWrite
+            machineForget(machine);
+        }
+    }
+    machine->idleStart = -1;
+    if (machine->nextInterrupt == 2) {
+        machine->frames++;
+        while (machine->sessionNext < machine->sessionCount &&
+               machine->session[machine->sessionNext].frame <= machine->frames) {
+            SessionEvent* event = &machine->session[machine->sessionNext++];
+            machine->inputs[event->port] = event->value;
+        }
+    }
+    machine->nextInterrupt = machine->nextInterrupt == 1 ? 2 : 1;
+    machine->interruptAt += CYCLES_PER_FRAME / 2;
+}
+
+// session file: one "frame port value" per line (decimal frame, hex port and
+// value), in frame order; lines starting with # are comments
+int machineLoadSession (Machine* machine, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+    char line[128];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long frame;
+        unsigned int port, value;
+        if (line[0] == '#' || sscanf(line, "%llu %x %x", &frame, &port, &value) != 3) {
+            continue;
+        }
+        if (port > 2) {
+            fprintf(stderr, "Error: %s: input port %u does not exist\n", path, port);
+            fclose(file);
+            return -1;
+        }
+        if (machine->sessionCount == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            machine->session = realloc(machine->session, capacity * sizeof(SessionEvent));
+        }
+        machine->session[machine->sessionCount].frame = frame;
+        machine->session[machine->sessionCount].port = port;
+        machine->session[machine->sessionCount].value = value;
+        machine->sessionCount++;
+    }
+    fclose(file);
+    return 0;
+}
+
+void machineFree (Machine* machine) {
+    free(machine->session);
+    machine->session = NULL;
+    machine->sessionCount = machine->sessionNext = 0;
+}
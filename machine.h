@@ -0,0 +1,80 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdint.h>
+#include "i8080.h"
+#include "aot.h"
+
+// Space Invaders board around the cpu: input ports, the external shift
+// register and the two video interrupts (RST 1 mid-screen, RST 2 at vblank)
+// the run loop calls machineTick at block boundaries, so interrupts are
+// taken at the first block start after their time. machineRunBlock also
+// spots the game's wait-for-interrupt loops and skips to the interrupt, and
+// machineHalt does the same for HLT. hot instruction sequences in the rom run
+// as single fused handlers, see machine.c
+
+#define CPU_HZ 2000000
+#define FRAME_HZ 60
+#define CYCLES_PER_FRAME (CPU_HZ / FRAME_HZ)
+
+#define IDLE_MAX_INSTRUCTIONS 16   // longest wait loop body looked at
+
+#define ROM_SIZE 0x2000
+#define VRAM_START 0x2400
+#define VRAM_SIZE 0x1C00
+
+// IN 1 bits
+#define INPUT_COIN 0x01
+#define INPUT_P2_START 0x02
+#define INPUT_P1_START 0x04
+#define INPUT_P1_SHOT 0x10
+#define INPUT_P1_LEFT 0x20
+#define INPUT_P1_RIGHT 0x40
+
+// one input change from a session file, applied at the vblank of its frame
+typedef struct {
+    uint64_t frame;
+    uint8_t port;
+    uint8_t value;
+} SessionEvent;
+
+typedef struct {
+    uint8_t inputs[3];          // IN 0-2
+    uint16_t shift;
+    uint8_t shiftOffset;
+    uint8_t sound[2];           // last OUT 3 and OUT 5
+    int nextInterrupt;          // 1 mid-screen, 2 vblank
+    uint64_t interruptAt;       // state->cycles when it is due
+    uint64_t frames;
+
+    SessionEvent* session;      // fixed input script, NULL when none is loaded
+    int sessionCount;
+    int sessionNext;
+
+    bool idleSkip;              // fast-forward wait loops in machineRunBlock, on by default
+    int32_t idleStart;          // block that just jumped back to itself, -1 when none
+    uint64_t idleRegisters;     // A-L and flags when it did
+    uint16_t idleSp;
+    uint64_t idleCycles;
+    uint64_t idleSkipped;       // states fast-forwarded through wait loops and HLT
+
+    bool aot;                   // run the recompiled rom in builds with it (aot.h), on by default
+    AotCache aotCache;          // what it has learned so far
+    bool fuse;                  // run fused handlers in machineRunBlock, on by default
+    uint8_t fusion[ROM_SIZE];   // FUSE_ kind starting at each rom address, 0 until decoded
+} Machine;
+
+void machineInit (Machine* machine, i8080* state);
+int machineLoadSession (Machine* machine, const char* path);
+void machineFree (Machine* machine);
+void machineInterrupt (Machine* machine, i8080* state);
+bool machineHalt (Machine* machine, i8080* state);
+int machineRunBlock (Machine* machine, i8080* state);
+
+static inline void machineTick (Machine* machine, i8080* state) {
+    if (state->cycles >= machine->interruptAt) {
+        machineInterrupt(machine, state);
+    }
+}
+
+#endif
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <string.h>
+#include "opcodes.h"
+
+const OpcodeInfo opcodeTable[256] = {
+//   mnemonic    operand       len st  taken flags        flow            effects
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x00
+    {"LXI B",    OPERAND_D16,  3, 10, 10, 0,           FLOW_NONE,      0              }, // 0x01
+    {"STAX B",   OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x02
+    {"INX B",    OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x03
+    {"INR B",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x04
+    {"DCR B",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x05
+    {"MVI B",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x06
+    {"RLC",      OPERAND_NONE, 1,  4,  4, CARRY_MASK,  FLOW_NONE,      0              }, // 0x07
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x08
+    {"DAD B",    OPERAND_NONE, 1, 10, 10, CARRY_MASK,  FLOW_NONE,      0              }, // 0x09
+    {"LDAX B",   OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x0A
+    {"DCX B",    OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x0B
+    {"INR C",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x0C
+    {"DCR C",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x0D
+    {"MVI C",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x0E
+    {"RRC",      OPERAND_NONE, 1,  4,  4, CARRY_MASK,  FLOW_NONE,      0              }, // 0x0F
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x10
+    {"LXI D",    OPERAND_D16,  3, 10, 10, 0,           FLOW_NONE,      0              }, // 0x11
+    {"STAX D",   OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x12
+    {"INX D",    OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x13
+    {"INR D",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x14
+    {"DCR D",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x15
+    {"MVI D",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x16
+    {"RAL",      OPERAND_NONE, 1,  4,  4, CARRY_MASK,  FLOW_NONE,      0              }, // 0x17
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x18
+    {"DAD D",    OPERAND_NONE, 1, 10, 10, CARRY_MASK,  FLOW_NONE,      0              }, // 0x19
+    {"LDAX D",   OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x1A
+    {"DCX D",    OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x1B
+    {"INR E",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x1C
+    {"DCR E",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x1D
+    {"MVI E",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x1E
+    {"RAR",      OPERAND_NONE, 1,  4,  4, CARRY_MASK,  FLOW_NONE,      0              }, // 0x1F
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x20
+    {"LXI H",    OPERAND_D16,  3, 10, 10, 0,           FLOW_NONE,      0              }, // 0x21
+    {"SHLD",     OPERAND_ADDR, 3, 16, 16, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x22
+    {"INX H",    OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x23
+    {"INR H",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x24
+    {"DCR H",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x25
+    {"MVI H",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x26
+    {"DAA",      OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x27
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x28
+    {"DAD H",    OPERAND_NONE, 1, 10, 10, CARRY_MASK,  FLOW_NONE,      0              }, // 0x29
+    {"LHLD",     OPERAND_ADDR, 3, 16, 16, 0,           FLOW_NONE,      0              }, // 0x2A
+    {"DCX H",    OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x2B
+    {"INR L",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x2C
+    {"DCR L",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x2D
+    {"MVI L",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x2E
+    {"CMA",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x2F
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x30
+    {"LXI SP",   OPERAND_D16,  3, 10, 10, 0,           FLOW_NONE,      0              }, // 0x31
+    {"STA",      OPERAND_ADDR, 3, 13, 13, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x32
+    {"INX SP",   OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x33
+    {"INR M",    OPERAND_NONE, 1, 10, 10, FLAGS_SZAP,  FLOW_NONE,      EFFECT_STORE   }, // 0x34
+    {"DCR M",    OPERAND_NONE, 1, 10, 10, FLAGS_SZAP,  FLOW_NONE,      EFFECT_STORE   }, // 0x35
+    {"MVI M",    OPERAND_D8,   2, 10, 10, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x36
+    {"STC",      OPERAND_NONE, 1,  4,  4, CARRY_MASK,  FLOW_NONE,      0              }, // 0x37
+    {"NOP",      OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      0              }, // 0x38
+    {"DAD SP",   OPERAND_NONE, 1, 10, 10, CARRY_MASK,  FLOW_NONE,      0              }, // 0x39
+    {"LDA",      OPERAND_ADDR, 3, 13, 13, 0,           FLOW_NONE,      0              }, // 0x3A
+    {"DCX SP",   OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x3B
+    {"INR A",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x3C
+    {"DCR A",    OPERAND_NONE, 1,  5,  5, FLAGS_SZAP,  FLOW_NONE,      0              }, // 0x3D
+    {"MVI A",    OPERAND_D8,   2,  7,  7, 0,           FLOW_NONE,      0              }, // 0x3E
+    {"CMC",      OPERAND_NONE, 1,  4,  4, CARRY_MASK,  FLOW_NONE,      0              }, // 0x3F
+    {"MOV B,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x40
+    {"MOV B,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x41
+    {"MOV B,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x42
+    {"MOV B,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x43
+    {"MOV B,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x44
+    {"MOV B,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x45
+    {"MOV B,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x46
+    {"MOV B,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x47
+    {"MOV C,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x48
+    {"MOV C,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x49
+    {"MOV C,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x4A
+    {"MOV C,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x4B
+    {"MOV C,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x4C
+    {"MOV C,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x4D
+    {"MOV C,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x4E
+    {"MOV C,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x4F
+    {"MOV D,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x50
+    {"MOV D,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x51
+    {"MOV D,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x52
+    {"MOV D,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x53
+    {"MOV D,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x54
+    {"MOV D,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x55
+    {"MOV D,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x56
+    {"MOV D,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x57
+    {"MOV E,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x58
+    {"MOV E,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x59
+    {"MOV E,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x5A
+    {"MOV E,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x5B
+    {"MOV E,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x5C
+    {"MOV E,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x5D
+    {"MOV E,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x5E
+    {"MOV E,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x5F
+    {"MOV H,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x60
+    {"MOV H,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x61
+    {"MOV H,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x62
+    {"MOV H,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x63
+    {"MOV H,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x64
+    {"MOV H,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x65
+    {"MOV H,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x66
+    {"MOV H,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x67
+    {"MOV L,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x68
+    {"MOV L,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x69
+    {"MOV L,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x6A
+    {"MOV L,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x6B
+    {"MOV L,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x6C
+    {"MOV L,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x6D
+    {"MOV L,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x6E
+    {"MOV L,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x6F
+    {"MOV M,B",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x70
+    {"MOV M,C",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x71
+    {"MOV M,D",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x72
+    {"MOV M,E",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x73
+    {"MOV M,H",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x74
+    {"MOV M,L",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x75
+    {"HLT",      OPERAND_NONE, 1,  7,  7, 0,           FLOW_HALT,      EFFECT_CONTROL }, // 0x76
+    {"MOV M,A",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0x77
+    {"MOV A,B",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x78
+    {"MOV A,C",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x79
+    {"MOV A,D",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x7A
+    {"MOV A,E",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x7B
+    {"MOV A,H",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x7C
+    {"MOV A,L",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x7D
+    {"MOV A,M",  OPERAND_NONE, 1,  7,  7, 0,           FLOW_NONE,      0              }, // 0x7E
+    {"MOV A,A",  OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0x7F
+    {"ADD B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x80
+    {"ADD C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x81
+    {"ADD D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x82
+    {"ADD E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x83
+    {"ADD H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x84
+    {"ADD L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x85
+    {"ADD M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x86
+    {"ADD A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x87
+    {"ADC B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x88
+    {"ADC C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x89
+    {"ADC D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x8A
+    {"ADC E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x8B
+    {"ADC H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x8C
+    {"ADC L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x8D
+    {"ADC M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x8E
+    {"ADC A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x8F
+    {"SUB B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x90
+    {"SUB C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x91
+    {"SUB D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x92
+    {"SUB E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x93
+    {"SUB H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x94
+    {"SUB L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x95
+    {"SUB M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x96
+    {"SUB A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x97
+    {"SBB B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x98
+    {"SBB C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x99
+    {"SBB D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x9A
+    {"SBB E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x9B
+    {"SBB H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x9C
+    {"SBB L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x9D
+    {"SBB M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x9E
+    {"SBB A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0x9F
+    {"ANA B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA0
+    {"ANA C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA1
+    {"ANA D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA2
+    {"ANA E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA3
+    {"ANA H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA4
+    {"ANA L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA5
+    {"ANA M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA6
+    {"ANA A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA7
+    {"XRA B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA8
+    {"XRA C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xA9
+    {"XRA D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xAA
+    {"XRA E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xAB
+    {"XRA H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xAC
+    {"XRA L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xAD
+    {"XRA M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xAE
+    {"XRA A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xAF
+    {"ORA B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB0
+    {"ORA C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB1
+    {"ORA D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB2
+    {"ORA E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB3
+    {"ORA H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB4
+    {"ORA L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB5
+    {"ORA M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB6
+    {"ORA A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB7
+    {"CMP B",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB8
+    {"CMP C",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xB9
+    {"CMP D",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xBA
+    {"CMP E",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xBB
+    {"CMP H",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xBC
+    {"CMP L",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xBD
+    {"CMP M",    OPERAND_NONE, 1,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xBE
+    {"CMP A",    OPERAND_NONE, 1,  4,  4, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xBF
+    {"RNZ",      OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xC0
+    {"POP B",    OPERAND_NONE, 1, 10, 10, 0,           FLOW_NONE,      0              }, // 0xC1
+    {"JNZ",      OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xC2
+    {"JMP",      OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP,      0              }, // 0xC3
+    {"CNZ",      OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xC4
+    {"PUSH B",   OPERAND_NONE, 1, 11, 11, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0xC5
+    {"ADI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xC6
+    {"RST 0",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xC7
+    {"RZ",       OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xC8
+    {"RET",      OPERAND_NONE, 1, 10, 10, 0,           FLOW_RET,       0              }, // 0xC9
+    {"JZ",       OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xCA
+    {"JMP",      OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP,      0              }, // 0xCB
+    {"CZ",       OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xCC
+    {"CALL",     OPERAND_ADDR, 3, 17, 17, 0,           FLOW_CALL,      EFFECT_STORE   }, // 0xCD
+    {"ACI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xCE
+    {"RST 1",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xCF
+    {"RNC",      OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xD0
+    {"POP D",    OPERAND_NONE, 1, 10, 10, 0,           FLOW_NONE,      0              }, // 0xD1
+    {"JNC",      OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xD2
+    {"OUT",      OPERAND_D8,   2, 10, 10, 0,           FLOW_NONE,      EFFECT_PORT    }, // 0xD3
+    {"CNC",      OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xD4
+    {"PUSH D",   OPERAND_NONE, 1, 11, 11, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0xD5
+    {"SUI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xD6
+    {"RST 2",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xD7
+    {"RC",       OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xD8
+    {"RET",      OPERAND_NONE, 1, 10, 10, 0,           FLOW_RET,       0              }, // 0xD9
+    {"JC",       OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xDA
+    {"IN",       OPERAND_D8,   2, 10, 10, 0,           FLOW_NONE,      EFFECT_PORT    }, // 0xDB
+    {"CC",       OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xDC
+    {"CALL",     OPERAND_ADDR, 3, 17, 17, 0,           FLOW_CALL,      EFFECT_STORE   }, // 0xDD
+    {"SBI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xDE
+    {"RST 3",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xDF
+    {"RPO",      OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xE0
+    {"POP H",    OPERAND_NONE, 1, 10, 10, 0,           FLOW_NONE,      0              }, // 0xE1
+    {"JPO",      OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xE2
+    {"XTHL",     OPERAND_NONE, 1, 18, 18, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0xE3
+    {"CPO",      OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xE4
+    {"PUSH H",   OPERAND_NONE, 1, 11, 11, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0xE5
+    {"ANI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xE6
+    {"RST 4",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xE7
+    {"RPE",      OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xE8
+    {"PCHL",     OPERAND_NONE, 1,  5,  5, 0,           FLOW_PCHL,      0              }, // 0xE9
+    {"JPE",      OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xEA
+    {"XCHG",     OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0xEB
+    {"CPE",      OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xEC
+    {"CALL",     OPERAND_ADDR, 3, 17, 17, 0,           FLOW_CALL,      EFFECT_STORE   }, // 0xED
+    {"XRI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xEE
+    {"RST 5",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xEF
+    {"RP",       OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xF0
+    {"POP PSW",  OPERAND_NONE, 1, 10, 10, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xF1
+    {"JP",       OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xF2
+    {"DI",       OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      EFFECT_CONTROL }, // 0xF3
+    {"CP",       OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xF4
+    {"PUSH PSW", OPERAND_NONE, 1, 11, 11, 0,           FLOW_NONE,      EFFECT_STORE   }, // 0xF5
+    {"ORI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xF6
+    {"RST 6",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xF7
+    {"RM",       OPERAND_NONE, 1,  5, 11, 0,           FLOW_RET_COND,  0              }, // 0xF8
+    {"SPHL",     OPERAND_NONE, 1,  5,  5, 0,           FLOW_NONE,      0              }, // 0xF9
+    {"JM",       OPERAND_ADDR, 3, 10, 10, 0,           FLOW_JUMP_COND, 0              }, // 0xFA
+    {"EI",       OPERAND_NONE, 1,  4,  4, 0,           FLOW_NONE,      EFFECT_CONTROL }, // 0xFB
+    {"CM",       OPERAND_ADDR, 3, 11, 17, 0,           FLOW_CALL_COND, EFFECT_STORE   }, // 0xFC
+    {"CALL",     OPERAND_ADDR, 3, 17, 17, 0,           FLOW_CALL,      EFFECT_STORE   }, // 0xFD
+    {"CPI",      OPERAND_D8,   2,  7,  7, FLAGS_ALL,   FLOW_NONE,      0              }, // 0xFE
+    {"RST 7",    OPERAND_NONE, 1, 11, 11, 0,           FLOW_RST,       EFFECT_STORE   }, // 0xFF
+};
+
+// the flag tables are written out by these macros; each entry is a constant
+// expression of its index, so the asserts below check the generators
+#define REPEAT4(M, n) M(n), M((n) + 1), M((n) + 2), M((n) + 3)
+#define REPEAT16(M, n) REPEAT4(M, n), REPEAT4(M, (n) + 4), REPEAT4(M, (n) + 8), REPEAT4(M, (n) + 12)
+#define REPEAT64(M, n) REPEAT16(M, n), REPEAT16(M, (n) + 16), REPEAT16(M, (n) + 32), REPEAT16(M, (n) + 48)
+#define REPEAT256(M, n) REPEAT64(M, n), REPEAT64(M, (n) + 64), REPEAT64(M, (n) + 128), REPEAT64(M, (n) + 192)
+#define REPEAT1024(M, n) REPEAT256(M, n), REPEAT256(M, (n) + 256), REPEAT256(M, (n) + 512), REPEAT256(M, (n) + 768)
+
+#define PARITY_EVEN(v) (!(((v) ^ (v) >> 1 ^ (v) >> 2 ^ (v) >> 3 ^ (v) >> 4 ^ (v) >> 5 ^ (v) >> 6 ^ (v) >> 7) & 1))
+#define SZP(v) (((v) & 0x80 ? SIGN_MASK : 0) | (((v) & 0xff) == 0 ? ZERO_MASK : 0) | \
+                (PARITY_EVEN(v) ? PARITY_MASK : 0))
+#define SZP_BITS(v) ((v) & (SIGN_MASK | ZERO_MASK | PARITY_MASK))
+
+// x, y: bit 3 of the operands as added, z: bit 3 of the result; the carry
+// into bit 3 is x ^ y ^ z and the carry out is the majority of the three.
+// a subtract adds the complement, and the 8080 sets AC when that carries
+#define MAJORITY(x, y, z) (((x) & (y)) | ((x) & (z)) | ((y) & (z)))
+#define HALF_CARRY_ADD(i) MAJORITY((i) >> 2 & 1, (i) >> 1 & 1, ((i) >> 2 ^ (i) >> 1 ^ (i)) & 1)
+#define HALF_CARRY_SUB(i) MAJORITY((i) >> 2 & 1, ~(i) >> 1 & 1, ((i) >> 2 ^ ~(i) >> 1 ^ (i)) & 1)
+
+// the high digit is also adjusted when the low digit's adjustment carries into a 9
+#define DAA_LOW(i) ((i) & 0x0f)
+#define DAA_HIGH(i) ((i) >> 4 & 0x0f)
+#define DAA_CARRY(i) (((i) & DAA_CARRY_IN) || DAA_HIGH(i) > 9 || (DAA_HIGH(i) == 9 && DAA_LOW(i) > 9))
+#define DAA_ADJUST(i) ((DAA_LOW(i) > 9 || ((i) & DAA_AC_IN) ? 0x06 : 0) | (DAA_CARRY(i) ? 0x60 : 0))
+#define DAA_ENTRY(i) ((((i) + DAA_ADJUST(i)) & 0xff) | \
+                      (DAA_LOW(i) + (DAA_ADJUST(i) & 0x0f) > 0x0f ? DAA_AC_OUT : 0) | \
+                      (DAA_CARRY(i) ? DAA_CARRY_OUT : 0))
+
+const uint8_t szpTable[512] = { REPEAT256(SZP, 0), REPEAT256(SZP_BITS, 0) };
+const uint8_t halfCarryAdd[8] = { REPEAT4(HALF_CARRY_ADD, 0), REPEAT4(HALF_CARRY_ADD, 4) };
+const uint8_t halfCarrySub[8] = { REPEAT4(HALF_CARRY_SUB, 0), REPEAT4(HALF_CARRY_SUB, 4) };
+const uint16_t daaTable[1024] = { REPEAT1024(DAA_ENTRY, 0) };
+
+_Static_assert(SZP(0x00) == (ZERO_MASK | PARITY_MASK), "SZP 00");
+_Static_assert(SZP(0x01) == 0, "SZP 01");
+_Static_assert(SZP(0x03) == PARITY_MASK, "SZP 03");
+_Static_assert(SZP(0x80) == SIGN_MASK, "SZP 80");
+_Static_assert(SZP(0xFF) == (SIGN_MASK | PARITY_MASK), "SZP FF");
+_Static_assert(SZP_BITS(0xFF) == 0xC4, "SZP_DIRECT FF");
+_Static_assert(HALF_CARRY_ADD(HALF_CARRY_INDEX(0x0F, 0x01, 0x10)) == 1, "AC 0F + 01");
+_Static_assert(HALF_CARRY_ADD(HALF_CARRY_INDEX(0x08, 0x08, 0x10)) == 1, "AC 08 + 08");
+_Static_assert(HALF_CARRY_ADD(HALF_CARRY_INDEX(0x07, 0x08, 0x0F)) == 0, "AC 07 + 08");
+_Static_assert(HALF_CARRY_ADD(HALF_CARRY_INDEX(0x0F, 0x00, 0x10)) == 1, "AC 0F + 00 + carry");
+_Static_assert(HALF_CARRY_SUB(HALF_CARRY_INDEX(0x10, 0x01, 0x0F)) == 0, "AC 10 - 01");
+_Static_assert(HALF_CARRY_SUB(HALF_CARRY_INDEX(0x0F, 0x01, 0x0E)) == 1, "AC 0F - 01");
+_Static_assert(HALF_CARRY_SUB(HALF_CARRY_INDEX(0x08, 0x08, 0x00)) == 1, "AC 08 - 08");
+_Static_assert(HALF_CARRY_SUB(HALF_CARRY_INDEX(0x00, 0x08, 0xF8)) == 0, "AC 00 - 08");
+_Static_assert(DAA_ENTRY(0x15) == 0x15, "DAA 15");
+_Static_assert(DAA_ENTRY(0x15 | DAA_AC_IN) == 0x1B, "DAA 15 AC");
+_Static_assert(DAA_ENTRY(0x0A) == (0x10 | DAA_AC_OUT), "DAA 0A");
+_Static_assert(DAA_ENTRY(0x9A) == (0x00 | DAA_AC_OUT | DAA_CARRY_OUT), "DAA 9A");
+_Static_assert(DAA_ENTRY(0x00 | DAA_CARRY_IN) == (0x60 | DAA_CARRY_OUT), "DAA 00 C");
+_Static_assert(DAA_ENTRY(0xA0) == (0x00 | DAA_CARRY_OUT), "DAA A0");
+
+// PSW bits an instruction reads, the other half of opcodeTable's flags for
+// liveness: the conditions of Jcc, Ccc and Rcc, the carry into ADC, SBB,
+// ACI, SBI, RAL, RAR and CMC, both carries into DAA, and all of PUSH PSW
+uint8_t opcodeFlagsRead (uint8_t opcode) {
+    static const uint8_t conditions[4] = { ZERO_MASK, CARRY_MASK, PARITY_MASK, SIGN_MASK };
+    uint8_t kind = opcode & 0xC7;
+    if (kind == 0xC0 || kind == 0xC2 || kind == 0xC4) {
+        return conditions[(opcode >> 4) & 3];
+    }
+    if ((opcode & 0xF0) == 0x80 || (opcode & 0xF0) == 0x90) {
+        return (opcode & 0x08) ? CARRY_MASK : 0;
+    }
+    switch (opcode) {
+        case 0xCE:
+        case 0xDE:
+        case 0x17:
+        case 0x1F:
+        case 0x3F:
+            return CARRY_MASK;
+        case 0x27:
+            return CARRY_MASK | AC_MASK;
+        case 0xF5:
+            return FLAGS_ALL;
+        default:
+            return 0;
+    }
+}
+
+// operands follow a register with a comma ("MVI B,$10") and a bare mnemonic with a space ("JMP $0000")
+int formatInstruction (uint8_t opcode, uint8_t low, uint8_t high, char* out, size_t size) {
+    const OpcodeInfo* info = &opcodeTable[opcode];
+    const char* separator = strchr(info->mnemonic, ' ') ? "," : " ";
+    switch (info->operand) {
+    case OPERAND_D8:
+        snprintf(out, size, "%s%s$%02X", info->mnemonic, separator, low);
+        break;
+    case OPERAND_D16:
+    case OPERAND_ADDR:
+        snprintf(out, size, "%s%s$%04X", info->mnemonic, separator, (high << 8) | low);
+        break;
+    default:
+        snprintf(out, size, "%s", info->mnemonic);
+        break;
+    }
+    return info->length;
+}
+
+// text of the instruction at pc in a 64 KB address space, returns its length
+int disassemble (const uint8_t* memory, uint16_t pc, char* out, size_t size) {
+    return formatInstruction(memory[pc], memory[(uint16_t)(pc + 1)], memory[(uint16_t)(pc + 2)], out, size);
+}
@@ -0,0 +1,82 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// PSW bit positions
+#define CARRY_MASK ((1 << 1) - 1) << 0
+#define PARITY_MASK ((1 << 1)- 1) << 2
+#define AC_MASK ((1 << 1)- 1) << 4
+#define ZERO_MASK ((1 << 1)- 1) << 6
+#define SIGN_MASK ((1 << 1)- 1) << 7
+
+#define FLAGS_SZAP (SIGN_MASK | ZERO_MASK | AC_MASK | PARITY_MASK)
+#define FLAGS_ALL (FLAGS_SZAP | CARRY_MASK)
+
+enum {
+    OPERAND_NONE,
+    OPERAND_D8,     // immediate byte
+    OPERAND_D16,    // immediate word
+    OPERAND_ADDR,   // word used as a memory or branch address
+};
+
+enum {
+    FLOW_NONE,
+    FLOW_JUMP,
+    FLOW_JUMP_COND,
+    FLOW_CALL,
+    FLOW_CALL_COND,
+    FLOW_RET,
+    FLOW_RET_COND,
+    FLOW_RST,
+    FLOW_PCHL,
+    FLOW_HALT,
+    FLOW_TRAP,      // not an opcode class: the core ended the block early (watchpoint hit)
+};
+
+// side effects beyond registers, flags and pc, for analyses of code ahead of time
+#define EFFECT_STORE 0x01       // writes memory, stack pushes included
+#define EFFECT_PORT 0x02        // IN or OUT
+#define EFFECT_CONTROL 0x04     // EI, DI or HLT
+
+// one row per opcode; the interpreter takes length and states from here,
+// the disassembler, trace decoder and debugger take the mnemonics
+typedef struct {
+    const char* mnemonic;   // without the operand, e.g. "MVI B" or "JMP"
+    uint8_t operand;
+    uint8_t length;
+    uint8_t cycles;         // states; not taken for conditional calls and returns
+    uint8_t cyclesTaken;
+    uint8_t flags;          // PSW bits written
+    uint8_t flow;
+    uint8_t effects;        // EFFECT_ bits
+} OpcodeInfo;
+
+extern const OpcodeInfo opcodeTable[256];
+
+// flag tables, expanded by the preprocessor in opcodes.c so they are plain
+// read-only data with nothing computed at startup
+extern const uint8_t szpTable[512];     // S, Z and P of a result byte, PSW layout
+extern const uint8_t halfCarryAdd[8];   // AC after an add, by HALF_CARRY_INDEX
+extern const uint8_t halfCarrySub[8];   // AC after a subtract or compare
+extern const uint16_t daaTable[1024];   // by A | DAA_CARRY_IN | DAA_AC_IN: new A | DAA_ flags
+
+// bit 3 of both operands and of the result give the carry out of bit 3,
+// with or without a carry in
+#define HALF_CARRY_INDEX(a, value, answer) \
+    ((((a) & 0x08) >> 1) | (((value) & 0x08) >> 2) | (((answer) & 0x08) >> 3))
+
+// szpTable[SZP_DIRECT | psw] is psw's own S, Z and P, for split flags restored by POP PSW
+#define SZP_DIRECT 0x100
+
+#define DAA_CARRY_IN 0x100
+#define DAA_AC_IN 0x200
+#define DAA_AC_OUT 0x100
+#define DAA_CARRY_OUT 0x200
+
+uint8_t opcodeFlagsRead (uint8_t opcode);
+int disassemble (const uint8_t* memory, uint16_t pc, char* out, size_t size);
+int formatInstruction (uint8_t opcode, uint8_t low, uint8_t high, char* out, size_t size);
+
+#endif
@@ -0,0 +1,293 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "profile.h"
+
+Profile* profileCreate (void) {
+    return calloc(1, sizeof(Profile));
+}
+
+void profileDestroy (Profile* profile) {
+    free(profile);
+}
+
+typedef struct {
+    uint32_t key;
+    uint64_t count;
+    uint64_t cycles;
+    uint32_t calls;
+} ProfileRow;
+
+static int byCycles (const void* lhs, const void* rhs) {
+    const ProfileRow* a = lhs;
+    const ProfileRow* b = rhs;
+    if (a->cycles != b->cycles) {
+        return a->cycles < b->cycles ? 1 : -1;
+    }
+    return a->key < b->key ? -1 : (a->key > b->key);
+}
+
+static void printRows (FILE* out, const ProfileRow* rows, int n, int top, uint64_t total, const char* format) {
+    for (int i = 0; i < n && i < top; i++) {
+        fprintf(out, format, rows[i].key);
+        fprintf(out, " %14llu %14llu %6.2f%%", (unsigned long long) rows[i].count,
+                (unsigned long long) rows[i].cycles, total ? 100.0 * rows[i].cycles / total : 0.0);
+        if (rows[i].calls) {
+            fprintf(out, " %10u", rows[i].calls);
+        }
+        fputc('\n', out);
+    }
+}
+
+// routines are the addresses entered through CALL/RST; every executed PC is
+// charged to the closest routine entry at or below it (self time)
+void profileReport (const Profile* profile, FILE* out, int top) {
+    ProfileRow* rows = malloc(65536 * sizeof(ProfileRow));
+    if (!rows) {
+        return;
+    }
+    uint64_t total = profile->cycles;
+    fprintf(out, "\nprofile: %llu instructions, %llu states\n",
+            (unsigned long long) profile->instructions, (unsigned long long) total);
+
+    int n = 0;
+    for (int op = 0; op < 256; op++) {
+        if (profile->opcodes[op].count) {
+            rows[n++] = (ProfileRow) {op, profile->opcodes[op].count, profile->opcodes[op].cycles, 0};
+        }
+    }
+    qsort(rows, n, sizeof(ProfileRow), byCycles);
+    fprintf(out, "\ntop opcodes      executions         states\n");
+    printRows(out, rows, n, top, total, "  %02X  ");
+
+    n = 0;
+    for (int pc = 0; pc < 65536; pc++) {
+        if (profile->pcs[pc].count) {
+            rows[n++] = (ProfileRow) {pc, profile->pcs[pc].count, profile->pcs[pc].cycles, 0};
+        }
+    }
+    qsort(rows, n, sizeof(ProfileRow), byCycles);
+    fprintf(out, "\ntop pcs          executions         states\n");
+    printRows(out, rows, n, top, total, "  %04X");
+
+    n = 0;
+    int routine = -1;
+    for (int pc = 0; pc < 65536; pc++) {
+        if (profile->calls[pc]) {
+            routine = n;
+            rows[n++] = (ProfileRow) {pc, 0, 0, profile->calls[pc]};
+        }
+        if (routine >= 0) {
+            rows[routine].count += profile->pcs[pc].count;
+            rows[routine].cycles += profile->pcs[pc].cycles;
+        }
+    }
+    qsort(rows, n, sizeof(ProfileRow), byCycles);
+    fprintf(out, "\ntop routines     executions         states             calls\n");
+    printRows(out, rows, n, top, total, "  %04X");
+
+    free(rows);
+}
+
+Sampler* samplerCreate (uint64_t interval, uint16_t root) {
+    Sampler* sampler = calloc(1, sizeof(Sampler));
+    if (!sampler) {
+        return NULL;
+    }
+    sampler->interval = interval ? interval : 1;
+    sampler->next = sampler->interval;
+    sampler->root = root;
+    return sampler;
+}
+
+void samplerDestroy (Sampler* sampler) {
+    for (int i = 0; i < sampler->symbolCount; i++) {
+        free(sampler->symbols[i].name);
+    }
+    free(sampler->symbols);
+    free(sampler->samples);
+    free(sampler);
+}
+
+void samplerTake (Sampler* sampler, uint16_t pc, uint64_t cycles) {
+    const ShadowStack* shadow = &sampler->shadow;
+    size_t need = shadow->depth + 2;
+    if (sampler->used + need > sampler->capacity) {
+        size_t capacity = sampler->capacity ? sampler->capacity * 2 : 65536;
+        uint16_t* samples = realloc(sampler->samples, capacity * sizeof(uint16_t));
+        if (!samples) {
+            return;
+        }
+        sampler->samples = samples;
+        sampler->capacity = capacity;
+    }
+    uint16_t* out = &sampler->samples[sampler->used];
+    *out++ = shadow->depth;
+    for (int i = 0; i < shadow->depth; i++) {
+        *out++ = shadow->entry[i];
+    }
+    *out = pc;
+    sampler->used += need;
+
+    // keep the sampling grid even if an instruction overshot it
+    sampler->next += sampler->interval * ((cycles - sampler->next) / sampler->interval + 1);
+}
+
+static int bySymbolAddress (const void* lhs, const void* rhs) {
+    const Symbol* a = lhs;
+    const Symbol* b = rhs;
+    return (int) a->address - (int) b->address;
+}
+
+static int parseAddress (const char* text, uint16_t* address) {
+    char* end;
+    if (*text == '$') {
+        text++;
+    }
+    unsigned long value = strtoul(text, &end, 16);
+    if (end == text || value > 0xffff || (*end && *end != 'h' && *end != 'H' && *end != ':')) {
+        return 0;
+    }
+    *address = (uint16_t) value;
+    return 1;
+}
+
+// accepts "<addr> <name>", "<name> = <addr>" and "<name> equ <addr>" lines,
+// addresses in hex with optional 0x, $ or h decoration; anything else is skipped
+int samplerLoadSymbols (Sampler* sampler, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+
+    char line[256];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file)) {
+        char first[128], second[128], third[128];
+        int fields = sscanf(line, "%127s %127s %127s", first, second, third);
+        if (fields < 2 || first[0] == ';' || first[0] == '#') {
+            continue;
+        }
+
+        uint16_t address;
+        const char* name;
+        size_t length;
+        if (parseAddress(first, &address)) {
+            name = second;
+        }
+        else if (fields == 3 && (strcmp(second, "=") == 0 || strcasecmp(second, "equ") == 0) && parseAddress(third, &address)) {
+            name = first;
+        }
+        else {
+            continue;
+        }
+        length = strlen(name);
+        if (length && name[length - 1] == ':') {
+            length--;
+        }
+
+        if (sampler->symbolCount == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            sampler->symbols = realloc(sampler->symbols, capacity * sizeof(Symbol));
+        }
+        Symbol* symbol = &sampler->symbols[sampler->symbolCount++];
+        symbol->address = address;
+        symbol->name = malloc(length + 1);
+        memcpy(symbol->name, name, length);
+        symbol->name[length] = '\0';
+    }
+    fclose(file);
+
+    qsort(sampler->symbols, sampler->symbolCount, sizeof(Symbol), bySymbolAddress);
+    return 0;
+}
+
+// name of the closest symbol at or below the address, or the address itself
+static const char* samplerResolve (const Sampler* sampler, uint16_t address, char* buffer) {
+    int lo = 0, hi = sampler->symbolCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (sampler->symbols[mid].address <= address) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo > 0) {
+        return sampler->symbols[lo - 1].name;
+    }
+    sprintf(buffer, "%04X", address);
+    return buffer;
+}
+
+static int byString (const void* lhs, const void* rhs) {
+    return strcmp(*(char* const*) lhs, *(char* const*) rhs);
+}
+
+int samplerWriteFolded (const Sampler* sampler, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < sampler->used; i += sampler->samples[i] + 2) {
+        count++;
+    }
+    char** lines = malloc((count ? count : 1) * sizeof(char*));
+
+    size_t n = 0;
+    char buffer[8], leafBuffer[8];
+    for (size_t i = 0; i < sampler->used; i += sampler->samples[i] + 2) {
+        int depth = sampler->samples[i];
+        const uint16_t* frames = &sampler->samples[i + 1];
+        uint16_t pc = frames[depth];
+
+        size_t size = 8 * (depth + 3);
+        char* line = malloc(size);
+        int length = snprintf(line, size, "%s", samplerResolve(sampler, sampler->root, buffer));
+        for (int f = 0; f < depth; f++) {
+            const char* name = samplerResolve(sampler, frames[f], buffer);
+            size_t extra = strlen(name) + 2;
+            if (length + extra >= size) {
+                size = (length + extra) * 2;
+                line = realloc(line, size);
+            }
+            length += snprintf(line + length, size - length, ";%s", name);
+        }
+        // with symbols the leaf can name a label inside the current routine
+        if (sampler->symbolCount) {
+            const char* leaf = samplerResolve(sampler, pc, leafBuffer);
+            const char* top = samplerResolve(sampler, depth ? frames[depth - 1] : sampler->root, buffer);
+            if (strcmp(leaf, top) != 0) {
+                size_t extra = strlen(leaf) + 2;
+                if (length + extra >= size) {
+                    size = (length + extra) * 2;
+                    line = realloc(line, size);
+                }
+                snprintf(line + length, size - length, ";%s", leaf);
+            }
+        }
+        lines[n++] = line;
+    }
+
+    qsort(lines, n, sizeof(char*), byString);
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && strcmp(lines[i], lines[j]) == 0) {
+            j++;
+        }
+        fprintf(file, "%s %zu\n", lines[i], j - i);
+        i = j;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// exact execution profile: plain per-instance counters, no atomics, so one
+// Profile per emulated CPU can stay enabled in benchmark runs
+
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+} ProfileCounter;
+
+typedef struct {
+    ProfileCounter opcodes[256];
+    ProfileCounter pcs[65536];
+    uint32_t calls[65536];          // times each address was entered by CALL/RST
+    uint64_t instructions;
+    uint64_t cycles;
+} Profile;
+
+Profile* profileCreate (void);
+void profileDestroy (Profile* profile);
+void profileReport (const Profile* profile, FILE* out, int top);
+
+// pc and opcode of the instruction just executed, the states it took and where it went
+static inline void profileRecord (Profile* profile, uint16_t pc, uint8_t opcode, uint32_t cycles, uint16_t next) {
+    profile->opcodes[opcode].count++;
+    profile->opcodes[opcode].cycles += cycles;
+    profile->pcs[pc].count++;
+    profile->pcs[pc].cycles += cycles;
+    profile->instructions++;
+    profile->cycles += cycles;
+
+    // RST n (11nnn111), CALL and its aliases (11xx1101), and Ccc (11ccc100) when taken
+    if ((opcode & 0xC7) == 0xC7 || ((opcode & 0xC7) == 0xC4 && next != (uint16_t)(pc + 3)) || (opcode & 0xCF) == 0xCD) {
+        profile->calls[next]++;
+    }
+}
+
+// sampling profiler for the guest program: the run loop takes a sample every
+// `interval` states, and call/ret/rst in the core maintain a shadow call stack
+// so each sample becomes a folded stack (flamegraph.pl input)
+
+#define SHADOW_DEPTH 64
+
+typedef struct ShadowStack {
+    uint16_t entry[SHADOW_DEPTH];   // address each active routine was entered at
+    uint16_t ret[SHADOW_DEPTH];     // return address pushed when it was entered
+    int depth;
+    int overflow;                   // frames deeper than SHADOW_DEPTH, not recorded
+} ShadowStack;
+
+typedef struct {
+    uint16_t address;
+    char* name;
+} Symbol;
+
+typedef struct {
+    ShadowStack shadow;
+    uint64_t interval;
+    uint64_t next;                  // cycle count of the next sample
+    uint16_t root;                  // entry point of the outermost frame
+    uint16_t* samples;              // per sample: depth, frames..., pc
+    size_t used;
+    size_t capacity;
+    Symbol* symbols;                // sorted by address
+    int symbolCount;
+} Sampler;
+
+Sampler* samplerCreate (uint64_t interval, uint16_t root);
+void samplerDestroy (Sampler* sampler);
+int samplerLoadSymbols (Sampler* sampler, const char* path);
+void samplerTake (Sampler* sampler, uint16_t pc, uint64_t cycles);
+int samplerWriteFolded (const Sampler* sampler, const char* path);
+
+static inline void shadowCall (ShadowStack* shadow, uint16_t entry, uint16_t ret) {
+    if (shadow->depth == SHADOW_DEPTH) {
+        shadow->overflow++;
+        return;
+    }
+    shadow->entry[shadow->depth] = entry;
+    shadow->ret[shadow->depth] = ret;
+    shadow->depth++;
+}
+
+// pops to the frame whose return address matches; a RET used as a computed
+// jump (address pushed by hand) matches nothing and leaves the stack alone
+static inline void shadowRet (ShadowStack* shadow, uint16_t ret) {
+    if (shadow->overflow) {
+        shadow->overflow--;
+        return;
+    }
+    for (int i = shadow->depth - 1; i >= 0; i--) {
+        if (shadow->ret[i] == ret) {
+            shadow->depth = i;
+            return;
+        }
+    }
+}
+
+static inline void samplerTick (Sampler* sampler, uint16_t pc, uint64_t cycles) {
+    if (cycles >= sampler->next) {
+        samplerTake(sampler, pc, cycles);
+    }
+}
+
+#endif
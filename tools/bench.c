@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "../opcodes.h"
+#include "../i8080.h"
+#include "../machine.h"
+
+// per-opcode-class microbenchmarks for the core
+// each class is a loop of one instruction pattern repeated to fill LOOP_BYTES,
+// closed by a JMP back to 0000, so loop overhead is one jump in LOOP_BYTES/length.
+// every repetition runs a fixed instruction count and is timed separately
+// usage: bench [--engine name] [--count N] [--reps N] [--warmup N] [--only class] [--json file]
+// engines: interpreter (opcodeExtract, the default), split (the same core with
+// the split flags, splitStep) and board (machineStep, by machineRunBlock with
+// the fused handlers, wait loop skip and recompiled rom off). the board engine
+// runs whole blocks, so it runs until it has taken the states the interpreter
+// takes for the instruction count; every class is a fixed loop, so that is
+// the same instructions give or take the last block, and they are counted so
+
+// opcodeExtract with the split flags the board and CP/M cores keep
+#define CORE_STEP splitStep
+#define CORE_SPLIT_FLAGS
+#include "../i8080core.h"
+
+#define LOOP_BYTES 0x0C00
+#define SUBROUTINE 0x4000
+#define DATA 0x9000
+
+enum {
+    ENGINE_INTERPRETER,
+    ENGINE_SPLIT,
+    ENGINE_BOARD,
+    ENGINE_COUNT
+};
+
+static const char* const engines[ENGINE_COUNT] = { "interpreter", "split", "board" };
+
+typedef struct {
+    uint8_t* memory;
+    uint16_t at;
+} Emitter;
+
+typedef struct {
+    const char* name;
+    const char* description;
+    void (*body) (Emitter* out);        // one copy of the pattern at out->at
+    void (*setup) (i8080* state);
+} BenchClass;
+
+static void emitByte (Emitter* out, uint8_t byte) {
+    out->memory[out->at++] = byte;
+}
+
+static void emitWord (Emitter* out, uint8_t opcode, uint16_t word) {
+    emitByte(out, opcode);
+    emitByte(out, word & 0xff);
+    emitByte(out, word >> 8);
+}
+
+static void aluReg (Emitter* out) {
+    // ADD B, ADC C, SUB D, SBB E, ANA H, XRA L, ORA B, CMP C
+    static const uint8_t ops[] = { 0x80, 0x89, 0x92, 0x9B, 0xA4, 0xAD, 0xB0, 0xB9 };
+    for (int i = 0; i < 8; i++) {
+        emitByte(out, ops[i]);
+    }
+}
+
+static void aluImm (Emitter* out) {
+    // ADI ACI SUI SBI ANI XRI ORI CPI
+    for (int i = 0; i < 8; i++) {
+        emitByte(out, 0xC6 + i * 8);
+        emitByte(out, 0x35 + i * 0x11);
+    }
+}
+
+static void memory (Emitter* out) {
+    emitByte(out, 0x7E);                // MOV A, M
+    emitByte(out, 0x70);                // MOV M, B
+    emitWord(out, 0x32, DATA + 1);      // STA
+    emitWord(out, 0x3A, DATA + 2);      // LDA
+    emitByte(out, 0x0A);                // LDAX B
+    emitByte(out, 0x12);                // STAX D
+    emitByte(out, 0x34);                // INR M
+    emitByte(out, 0x86);                // ADD M
+}
+
+static void memorySetup (i8080* state) {
+    state->hl = state->bc = state->de = DATA;
+}
+
+// both branch classes jump to the next instruction, so only the decision differs
+static void branchTaken (Emitter* out) {
+    emitWord(out, 0xC2, out->at + 3);   // JNZ, Z is clear
+    emitWord(out, 0xD2, out->at + 3);   // JNC, C is clear
+}
+
+static void branchNotTaken (Emitter* out) {
+    emitWord(out, 0xCA, out->at + 3);   // JZ
+    emitWord(out, 0xDA, out->at + 3);   // JC
+}
+
+static void flagsClear (i8080* state) {
+    state->cc.z = 0;
+    state->cc.c = 0;
+}
+
+static void callRet (Emitter* out) {
+    emitWord(out, 0xCD, SUBROUTINE);    // CALL, the subroutine is a lone RET
+}
+
+static void stackSetup (i8080* state) {
+    state->sp = 0xF000;
+    state->memory[SUBROUTINE] = 0xC9;
+}
+
+static void pushPop (Emitter* out) {
+    emitByte(out, 0xC5);                // PUSH B
+    emitByte(out, 0xD5);                // PUSH D
+    emitByte(out, 0xE1);                // POP H
+    emitByte(out, 0xF1);                // POP PSW
+    emitByte(out, 0xF5);                // PUSH PSW
+    emitByte(out, 0xC1);                // POP B
+}
+
+static void movReg (Emitter* out) {
+    // MOV B,C  MOV D,E  MOV H,L  MOV A,B  MOV C,D  MOV E,H  MOV L,A  MOV A,E
+    static const uint8_t ops[] = { 0x41, 0x53, 0x65, 0x78, 0x4A, 0x5C, 0x6F, 0x7B };
+    for (int i = 0; i < 8; i++) {
+        emitByte(out, ops[i]);
+    }
+}
+
+static void incDec (Emitter* out) {
+    emitByte(out, 0x04);                // INR B
+    emitByte(out, 0x0D);                // DCR C
+    emitByte(out, 0x13);                // INX D
+    emitByte(out, 0x2B);                // DCX H
+    emitByte(out, 0x09);                // DAD B
+    emitByte(out, 0x3C);                // INR A
+}
+
+static const BenchClass classes[] = {
+    { "alu-reg", "ADD/ADC/SUB/SBB/ANA/XRA/ORA/CMP r", aluReg, NULL },
+    { "alu-imm", "ADI/ACI/SUI/SBI/ANI/XRI/ORI/CPI d8", aluImm, NULL },
+    { "mov-reg", "MOV r,r", movReg, NULL },
+    { "inc-dec", "INR/DCR/INX/DCX/DAD", incDec, NULL },
+    { "memory", "MOV r,M / MOV M,r / STA / LDA / LDAX / STAX / INR M / ADD M", memory, memorySetup },
+    { "branch-taken", "JNZ/JNC taken", branchTaken, flagsClear },
+    { "branch-not-taken", "JZ/JC not taken", branchNotTaken, flagsClear },
+    { "call-ret", "CALL + RET", callRet, stackSetup },
+    { "push-pop", "PUSH/POP incl. PSW", pushPop, stackSetup },
+};
+
+#define CLASS_COUNT (int) (sizeof(classes) / sizeof(classes[0]))
+
+typedef struct {
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    uint64_t cycles;        // states per repetition, to report emulated MHz
+} Summary;
+
+static double now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareDouble (const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static void prepare (i8080* state, const BenchClass* bench) {
+    memset(state, 0, sizeof(*state));
+    initializeState(state);
+    Emitter out = { state->memory, 0 };
+    while (out.at < LOOP_BYTES) {
+        bench->body(&out);
+    }
+    emitWord(&out, 0xC3, 0x0000);
+    if (bench->setup) {
+        bench->setup(state);
+    }
+}
+
+// runs count instructions on engine, or for the board engine whole blocks
+// until states have gone by, and returns the instructions run
+static uint64_t runEngine (i8080* state, Machine* machine, int engine, uint64_t count, uint64_t states) {
+    if (engine == ENGINE_INTERPRETER) {
+        for (uint64_t i = 0; i < count; i++) {
+            opcodeExtract(state);
+        }
+        return count;
+    }
+    if (engine == ENGINE_SPLIT) {
+        for (uint64_t i = 0; i < count; i++) {
+            splitStep(state);
+        }
+        return count;
+    }
+    uint64_t end = state->cycles + states;
+    while (state->cycles < end) {
+        machineRunBlock(machine, state);
+    }
+    return (uint64_t) ((double) count * (state->cycles - end + states) / states + 0.5);
+}
+
+// ns per instruction for each repetition
+static void run (const BenchClass* bench, int engine, uint64_t count, int reps, uint64_t warmup, double* samples,
+                 Summary* summary) {
+    static i8080 state;
+    static Machine machine;
+    // states the interpreter takes for count and warmup instructions
+    prepare(&state, bench);
+    for (uint64_t i = 0; i < count; i++) {
+        opcodeExtract(&state);
+    }
+    uint64_t states = state.cycles;
+    uint64_t warmupStates = (uint64_t) ((double) states * warmup / count);
+
+    prepare(&state, bench);
+    if (engine != ENGINE_INTERPRETER) {
+        loadSplitFlags(&state);
+    }
+    if (engine == ENGINE_BOARD) {
+        machineInit(&machine, &state);
+        machine.interruptAt = UINT64_MAX;
+        machine.idleSkip = false;
+        machine.fuse = false;
+        machine.aot = false;
+    }
+    runEngine(&state, &machine, engine, warmup, warmupStates);
+    for (int r = 0; r < reps; r++) {
+        uint64_t cycles = state.cycles;
+        double start = now();
+        uint64_t instructions = runEngine(&state, &machine, engine, count, states);
+        samples[r] = (now() - start) * 1e9 / instructions;
+        summary->cycles = (state.cycles - cycles) * count / instructions;
+    }
+
+    double sum = 0, squares = 0;
+    for (int r = 0; r < reps; r++) {
+        sum += samples[r];
+    }
+    summary->mean = sum / reps;
+    for (int r = 0; r < reps; r++) {
+        squares += (samples[r] - summary->mean) * (samples[r] - summary->mean);
+    }
+    summary->stddev = reps > 1 ? sqrt(squares / (reps - 1)) : 0;
+    qsort(samples, reps, sizeof(double), compareDouble);
+    summary->min = samples[0];
+    summary->median = reps % 2 ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+}
+
+int main (int argc, char** argv) {
+    int engine = ENGINE_INTERPRETER;
+    uint64_t count = 2000000;
+    uint64_t warmup = 500000;
+    int reps = 11;
+    const char* only = NULL;
+    const char* json = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            engine = 0;
+            while (engine < ENGINE_COUNT && strcmp(name, engines[engine]) != 0) {
+                engine++;
+            }
+            if (engine == ENGINE_COUNT) {
+                fprintf(stderr, "Error: Unknown engine %s (interpreter, split or board)\n", name);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        }
+        else {
+            fprintf(stderr, "usage: %s [--engine name] [--count N] [--reps N] [--warmup N] [--only class] [--json file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1 || count < 1) {
+        fprintf(stderr, "Error: --count and --reps must be positive\n");
+        return 1;
+    }
+
+    FILE* out = NULL;
+    if (json) {
+        out = fopen(json, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Could not open %s\n", json);
+            return 1;
+        }
+        fprintf(out, "{\n  \"engine\": \"%s\",\n  \"count\": %llu,\n  \"reps\": %d,\n  \"classes\": [",
+                engines[engine], (unsigned long long) count, reps);
+    }
+
+    double* samples = malloc(reps * sizeof(double));
+    printf("%-18s %9s %9s %9s %8s %9s\n", "class", "min ns", "median", "mean", "stddev", "MHz");
+    bool first = true;
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        const BenchClass* bench = &classes[c];
+        if (only && strcmp(only, bench->name) != 0) {
+            continue;
+        }
+        Summary summary;
+        run(bench, engine, count, reps, warmup, samples, &summary);
+        // emulated clock rate at the median speed
+        double mhz = summary.cycles / (summary.median * count * 1e-9) / 1e6;
+        printf("%-18s %9.3f %9.3f %9.3f %8.3f %9.1f\n", bench->name,
+               summary.min, summary.median, summary.mean, summary.stddev, mhz);
+        if (out) {
+            fprintf(out, "%s\n    { \"name\": \"%s\", \"instructions\": \"%s\", \"ns_min\": %.4f, \"ns_median\": %.4f, "
+                         "\"ns_mean\": %.4f, \"ns_stddev\": %.4f, \"states\": %llu, \"mhz\": %.2f }",
+                    first ? "" : ",", bench->name, bench->description, summary.min, summary.median,
+                    summary.mean, summary.stddev, (unsigned long long) summary.cycles, mhz);
+        }
+        first = false;
+    }
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+    free(samples);
+    return 0;
+}
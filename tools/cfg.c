@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../opcodes.h"
+#include "../cfg.h"
+#include "cpm.h"
+
+// recovers the static control flow graph of a binary image (see cfg.h) and
+// writes it out as text, with an optional symbol file naming the routines and
+// entry points that main --symbols and the profiler read
+// usage: cfg <file> [--org addr] [--entry addr]... [--limit addr] [-o out.cfg] [--symbols out.sym]
+// entries default to 0000 and the RST vectors, or the start of a .COM file,
+// which is loaded at 0100 with its BDOS calls returning at once
+
+#define ENTRY_MAX 64
+
+static uint8_t memory[65536];
+
+static double now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int writeSymbols (const Cfg* cfg, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+    for (int i = 0; i < cfg->count; i++) {
+        const CfgBlock* block = &cfg->blocks[i];
+        if (block->flags & CFG_ROUTINE) {
+            fprintf(file, "%04X sub_%04X\n", block->start, block->start);
+        }
+        else if (block->flags & CFG_ENTRY) {
+            fprintf(file, "%04X entry_%04X\n", block->start, block->start);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+int main (int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [--org addr] [--entry addr]... [--limit addr] [-o out.cfg] [--symbols out.sym]\n", argv[0]);
+        return 1;
+    }
+
+    bool cpm = cpmIsProgram(argv[1]);
+    uint16_t origin = cpm ? CPM_ORIGIN : 0x0000;
+    uint32_t limit = 0x10000;
+    uint16_t entries[ENTRY_MAX];
+    int entryCount = 0;
+    const char* output = "out.cfg";
+    const char* symbols = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--org") == 0 && i + 1 < argc) {
+            origin = (uint16_t) strtoul(argv[++i], NULL, 16);
+        }
+        else if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc && entryCount < ENTRY_MAX) {
+            entries[entryCount++] = (uint16_t) strtoul(argv[++i], NULL, 16);
+        }
+        else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = strtoul(argv[++i], NULL, 16);
+            limit = limit < 1 || limit > 0x10000 ? 0x10000 : limit;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc) {
+            symbols = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[1]);
+        return 1;
+    }
+    size_t size = fread(&memory[origin], 1, sizeof(memory) - origin, file);
+    fclose(file);
+
+    if (cpm) {
+        memory[0x0005] = 0xC9;
+    }
+    if (!entryCount) {
+        if (cpm) {
+            entries[entryCount++] = CPM_ORIGIN;
+        }
+        else {
+            for (int v = 0; v < 8; v++) {
+                entries[entryCount++] = v * 8;
+            }
+        }
+    }
+
+    Cfg cfg;
+    double start = now();
+    if (cfgBuild(&cfg, memory, limit, entries, entryCount) != 0) {
+        return 1;
+    }
+    double elapsed = now() - start;
+    if (cfgWrite(&cfg, output, argv[1]) != 0 || (symbols && writeSymbols(&cfg, symbols) != 0)) {
+        cfgFree(&cfg);
+        return 1;
+    }
+
+    int routines = 0;
+    uint32_t code = 0;
+    for (int i = 0; i < cfg.count; i++) {
+        routines += (cfg.blocks[i].flags & CFG_ROUTINE) != 0;
+    }
+    for (uint32_t a = 0; a < cfg.limit; a++) {
+        code += cfg.map[a] != CFG_DATA;
+    }
+    fprintf(stderr, "cfg: %s, %zu bytes at %04X: %d blocks, %d routines, %d loops, %u code bytes in %.2f ms\n",
+            argv[1], size, origin, cfg.count, routines, cfg.loops, code, elapsed * 1000);
+    cfgFree(&cfg);
+    return 0;
+}
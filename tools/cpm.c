@@ -0,0 +1,55 @@
+#include <string.h>
+#include <strings.h>
+#include "cpm.h"
+
+// the diagnostics only need flat memory and no ports (IN leaves A alone);
+// flags are split
+#define CORE_STEP cpmStep
+#define CORE_READ(state, address) ((state)->memory[address])
+#define CORE_WRITE(state, address, value) ((state)->memory[address] = (value))
+#define CORE_TRAP(state) 0
+#define CORE_IN(state, port) ((state)->a)
+#define CORE_OUT(state, port, value) ((void) 0)
+#define CORE_SHADOW_CALL(state, entry, ret)
+#define CORE_SHADOW_RET(state, ret)
+#define CORE_SPLIT_FLAGS
+#include "../i8080core.h"
+
+bool cpmIsProgram (const char* path) {
+    size_t length = strlen(path);
+    return length > 4 && strcasecmp(path + length - 4, ".com") == 0;
+}
+
+// call after the program is loaded at CPM_ORIGIN
+void cpmPrepare (i8080* state) {
+    state->memory[0x0005] = 0xC3;               // JMP BDOS, programs read the top of memory from 0006
+    state->memory[0x0006] = CPM_BDOS & 0xff;
+    state->memory[0x0007] = CPM_BDOS >> 8;
+    state->memory[CPM_BDOS] = 0xC9;             // RET, the work happens in cpmBdos
+    state->sp = CPM_BDOS;
+    state->pc = CPM_ORIGIN;
+}
+
+// out may be NULL to discard the output
+void cpmBdos (const i8080* state, FILE* out) {
+    if (!out) {
+        return;
+    }
+    if (state->c == 2) {
+        fputc(state->e, out);
+    }
+    else if (state->c == 9) {
+        for (uint16_t a = state->de; state->memory[a] != '$'; a++) {
+            fputc(state->memory[a], out);
+        }
+    }
+    fflush(out);
+}
+
+// runs to the end of the current basic block, returns its FLOW_ class
+int cpmRunBlock (i8080* state) {
+    int flow;
+    while (!(flow = cpmStep(state))) {
+    }
+    return flow;
+}
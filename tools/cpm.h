@@ -0,0 +1,22 @@
+#ifndef CPM_H
+#define CPM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "../i8080.h"
+
+// just enough CP/M to run the cpu diagnostics: programs load at 0100, CALL 5
+// reaches a RET at CPM_BDOS where the caller runs cpmBdos first (console
+// output, functions 2 and 9), and a jump to 0000 means the program is done.
+// cpmRunBlock is a core specialised for that: flat memory, no hooks or ports,
+// split flags (syncSplitFlags before reading cc)
+
+#define CPM_ORIGIN 0x0100
+#define CPM_BDOS 0xFE00
+
+bool cpmIsProgram (const char* path);
+void cpmPrepare (i8080* state);
+void cpmBdos (const i8080* state, FILE* out);
+int cpmRunBlock (i8080* state);
+
+#endif
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../opcodes.h"
+
+// disassembles a binary image using the shared opcode table
+// usage: disasm <file> [origin, default 0; 0x100 for CP/M .COM files]
+
+static uint8_t memory[65536];
+
+int main (int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [origin]\n", argv[0]);
+        return 1;
+    }
+    uint16_t origin = argc > 2 ? (uint16_t) strtoul(argv[2], NULL, 0) : 0;
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[1]);
+        return 1;
+    }
+    size_t size = fread(&memory[origin], 1, sizeof(memory) - origin, file);
+    fclose(file);
+
+    static char output[1 << 20];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+
+    char text[32];
+    uint32_t end = origin + (uint32_t) size;
+    for (uint32_t pc = origin; pc < end;) {
+        int length = disassemble(memory, (uint16_t) pc, text, sizeof(text));
+        switch (length) {
+        case 1:
+            printf("%04X  %02X        %s\n", pc, memory[pc], text);
+            break;
+        case 2:
+            printf("%04X  %02X %02X     %s\n", pc, memory[pc], memory[(uint16_t)(pc + 1)], text);
+            break;
+        default:
+            printf("%04X  %02X %02X %02X  %s\n", pc, memory[pc], memory[(uint16_t)(pc + 1)], memory[(uint16_t)(pc + 2)], text);
+            break;
+        }
+        pc += length;
+    }
+    return 0;
+}
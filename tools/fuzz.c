@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "../opcodes.h"
+#include "../i8080.h"
+#include "../machine.h"
+#include "refcore.h"
+#include "harness.h"
+
+// differential fuzz target: random registers, flags and pc plus a few random
+// instruction bytes, run through opcodeExtract() and the reference core, which
+// must end in the same state. new engines get compared here the same way.
+// libFuzzer:  make fuzz && ./fuzz -max_len=40
+// no clang:   make fuzz-random && ./fuzz [iterations] (or ./fuzz crash-file...)
+// recompiled: make aot-fuzz, the same with the board inputs below on the AOT engine
+//
+// input layout, FUZZ_HEADER bytes then code placed at pc:
+//   0 A, 1 flags (PSW layout), 2-7 B C D E H L, 8-9 SP, 10-11 PC,
+//   12 value read by IN, 13 instruction count - 1 (low 3 bits), bit 3 set runs
+//   splitStep instead of opcodeExtract, bit 4 set makes it a board input
+// the first code byte is the opcode, so every byte value reaches every opcode
+//
+// board inputs run the Space Invaders board engine (machine.h) instead, from
+// the rom in FUZZ_ROM with random ram, for a block count rather than an
+// instruction count. pc is taken into the rom and sp into ram, the code
+// bytes go on the stack so RET and POP see them, 12 is also what IN 0-2 read
+// and sets when the first interrupt is due, and bit 7 of 11 which one it is.
+// bits 5 and 6 of 13 turn off the fused handlers and the wait loop skip,
+// bit 7 the recompiled rom in builds with it. after every machineRunBlock
+// the reference catches up on its own interrupt schedule (see refBoardRun)
+// and everything, all of memory included, must match
+
+// opcodeExtract with the split flags the board and CP/M cores keep
+#define CORE_STEP splitStep
+#define CORE_SPLIT_FLAGS
+#include "../i8080core.h"
+
+#define FUZZ_HEADER 14
+#define FUZZ_CODE 26
+#define FUZZ_LOG 64         // stores per input: 8 instructions of at most 2 stores, plus the code
+#define FUZZ_ROM "space-invaders.rom"
+
+static i8080* core;
+static RefCpu* ref;
+static uint8_t pristine[MEMORY_SIZE];   // memory both cores start from, restored after each input
+static uint64_t coreDelta;
+static uint16_t written[FUZZ_LOG];
+static int writtenCount;
+static Ports ports;
+
+static i8080* boardCore;
+static RefCpu* boardRef;
+static Machine* machine;
+static RefBoard refBoard;
+static uint8_t boardImage[MEMORY_SIZE];     // the rom over pristine; machine stays NULL without the rom
+static uint64_t boardHash;
+
+static void hashHook (i8080* state, uint16_t address, uint8_t value, int access) {
+    (void) access;
+    coreDelta += refHashByte(address, value) - refHashByte(address, state->memory[address]);
+    if (writtenCount < FUZZ_LOG) {
+        written[writtenCount++] = address;
+    }
+}
+
+static void setup (void) {
+    core = calloc(1, sizeof(i8080));
+    ref = calloc(1, sizeof(RefCpu));
+    uint32_t x = 0x12345678;
+    for (int a = 0; a < MEMORY_SIZE; a++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        pristine[a] = (uint8_t) x;
+    }
+    memcpy(core->memory, pristine, MEMORY_SIZE);
+    memcpy(ref->memory, pristine, MEMORY_SIZE);
+    core->memoryHook = hashHook;
+    memset(core->pageHooks, PAGE_HOOK_WRITE, sizeof(core->pageHooks));
+    portsConnect(&ports, core, ref);
+
+    memcpy(boardImage, pristine, MEMORY_SIZE);
+    FILE* file = fopen(FUZZ_ROM, "rb");
+    if (!file || fread(boardImage, 1, ROM_SIZE, file) != ROM_SIZE) {
+        fprintf(stderr, "fuzz: no %s here, board inputs are skipped\n", FUZZ_ROM);
+    }
+    else {
+        boardCore = calloc(1, sizeof(i8080));
+        boardRef = calloc(1, sizeof(RefCpu));
+        machine = calloc(1, sizeof(Machine));
+        boardHash = refHashMemory(boardImage);
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+static void fail (const uint8_t* data, size_t size, const char* what, const i8080* state, const RefCpu* cpu) {
+    fprintf(stderr, "fuzz: %s differs\n  input:", what);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(stderr, " %02X", data[i]);
+    }
+    fprintf(stderr, "\n  core: PC=%04X SP=%04X A=%02X F=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X cycles=%llu\n"
+                    "  ref:  PC=%04X SP=%04X A=%02X F=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X cycles=%llu\n",
+            state->pc, state->sp, state->a, coreFlags(state), state->b, state->c, state->d, state->e, state->h, state->l,
+            (unsigned long long) state->cycles,
+            cpu->pc, cpu->sp, cpu->reg[REF_A], cpu->f, cpu->reg[REF_B], cpu->reg[REF_C], cpu->reg[REF_D],
+            cpu->reg[REF_E], cpu->reg[REF_H], cpu->reg[REF_L], (unsigned long long) cpu->cycles);
+    abort();
+}
+
+// the header's registers into both cores, interrupts enabled and no time run
+static void loadRegisters (i8080* state, RefCpu* cpu, const uint8_t* data) {
+    uint8_t flags = data[1];
+    state->a = data[0];
+    state->b = data[2];
+    state->c = data[3];
+    state->d = data[4];
+    state->e = data[5];
+    state->h = data[6];
+    state->l = data[7];
+    state->cc.c = (flags & CARRY_MASK) != 0;
+    state->cc.p = (flags & PARITY_MASK) != 0;
+    state->cc.ac = (flags & AC_MASK) != 0;
+    state->cc.z = (flags & ZERO_MASK) != 0;
+    state->cc.s = (flags & SIGN_MASK) != 0;
+    loadSplitFlags(state);
+    state->sp = data[8] | (data[9] << 8);
+    state->pc = data[10] | (data[11] << 8);
+    state->IE = 1;
+    state->halt = 0;
+    state->cycles = 0;
+
+    cpu->reg[REF_A] = state->a;
+    cpu->reg[REF_B] = state->b;
+    cpu->reg[REF_C] = state->c;
+    cpu->reg[REF_D] = state->d;
+    cpu->reg[REF_E] = state->e;
+    cpu->reg[REF_H] = state->h;
+    cpu->reg[REF_L] = state->l;
+    cpu->f = coreFlags(state);
+    cpu->sp = state->sp;
+    cpu->pc = state->pc;
+    cpu->ie = true;
+    cpu->halted = false;
+    cpu->cycles = 0;
+}
+
+static void compareRegisters (const uint8_t* data, size_t size, const i8080* state, const RefCpu* cpu) {
+    if (state->pc != cpu->pc || state->sp != cpu->sp || state->a != cpu->reg[REF_A] ||
+        state->b != cpu->reg[REF_B] || state->c != cpu->reg[REF_C] || state->d != cpu->reg[REF_D] ||
+        state->e != cpu->reg[REF_E] || state->h != cpu->reg[REF_H] || state->l != cpu->reg[REF_L]) {
+        fail(data, size, "registers", state, cpu);
+    }
+    if (coreFlags(state) != cpu->f) {
+        fail(data, size, "flags", state, cpu);
+    }
+    if (state->cycles != cpu->cycles || state->halt != cpu->halted || state->IE != cpu->ie) {
+        fail(data, size, "cycles, HLT or IE", state, cpu);
+    }
+}
+
+// a board input: blocks through machineRunBlock, as main runs the rom
+static void fuzzBoard (const uint8_t* data, size_t size) {
+    memcpy(boardCore->memory, boardImage, MEMORY_SIZE);
+    memcpy(boardRef->memory, boardImage, MEMORY_SIZE);
+    loadRegisters(boardCore, boardRef, data);
+    boardCore->pc = boardRef->pc = boardCore->pc % ROM_SIZE;
+    boardCore->sp = boardRef->sp = ROM_SIZE | (boardCore->sp & (ROM_SIZE - 1));
+    boardRef->hash = boardHash;
+    size_t length = size - FUZZ_HEADER < FUZZ_CODE ? size - FUZZ_HEADER : FUZZ_CODE;
+    for (size_t i = 0; i < length; i++) {
+        uint16_t address = (uint16_t)(boardCore->sp + i);
+        boardRef->hash += refHashByte(address, data[FUZZ_HEADER + i]) - refHashByte(address, boardImage[address]);
+        boardCore->memory[address] = boardRef->memory[address] = data[FUZZ_HEADER + i];
+    }
+
+    machineInit(machine, boardCore);
+    machine->inputs[0] = machine->inputs[1] = machine->inputs[2] = data[12];
+    machine->interruptAt = (data[12] + 1) * 64;
+    machine->nextInterrupt = (data[11] >> 7) + 1;
+    machine->fuse = (data[13] & 0x20) == 0;
+    machine->idleSkip = (data[13] & 0x40) == 0;
+#ifdef I8080_AOT
+    machine->aot = (data[13] & 0x80) == 0;
+#else
+    machine->aot = false;
+#endif
+    refBoardConnect(&refBoard, machine, boardRef);
+
+    int blocks = (data[13] & 7) + 1;
+    for (int i = 0; i < blocks; i++) {
+        machineTick(machine, boardCore);
+        if (boardCore->halt) {
+            if (!machineHalt(machine, boardCore)) {
+                break;
+            }
+        }
+        else {
+            machineRunBlock(machine, boardCore);
+            syncSplitFlags(boardCore);
+        }
+        refBoardRun(&refBoard, boardRef, boardCore->cycles);
+
+        compareRegisters(data, size, boardCore, boardRef);
+        if (!sameBoardPorts(&refBoard, machine)) {
+            fail(data, size, "board ports", boardCore, boardRef);
+        }
+        if (memcmp(boardCore->memory, boardRef->memory, MEMORY_SIZE) != 0) {
+            fail(data, size, "memory", boardCore, boardRef);
+        }
+    }
+}
+
+int LLVMFuzzerTestOneInput (const uint8_t* data, size_t size) {
+    if (size < FUZZ_HEADER + 1) {
+        return 0;
+    }
+    if (!core) {
+        setup();
+    }
+    if (data[13] & 0x10) {
+        if (machine) {
+            fuzzBoard(data, size);
+        }
+        return 0;
+    }
+
+    loadRegisters(core, ref, data);
+    memset(ports.in, data[12], sizeof(ports.in));
+    ports.outPort[0] = ports.outPort[1] = -1;
+    int steps = (data[13] & 7) + 1;
+    bool split = (data[13] & 0x08) != 0;
+
+    // code goes in through the hook so it is logged and restored like any store
+    coreDelta = 0;
+    writtenCount = 0;
+    size_t length = size - FUZZ_HEADER < FUZZ_CODE ? size - FUZZ_HEADER : FUZZ_CODE;
+    for (size_t i = 0; i < length; i++) {
+        uint16_t address = (uint16_t)(core->pc + i);
+        writeByte(core, address, data[FUZZ_HEADER + i]);
+        ref->memory[address] = data[FUZZ_HEADER + i];
+    }
+    ref->hash = coreDelta;
+
+    for (int i = 0; i < steps && !core->halt; i++) {
+        if (split) {
+            splitStep(core);
+        }
+        else {
+            opcodeExtract(core);
+        }
+        refStep(ref);
+    }
+    if (split) {
+        syncSplitFlags(core);
+    }
+
+    compareRegisters(data, size, core, ref);
+    if (!samePorts(&ports)) {
+        fail(data, size, "port output", core, ref);
+    }
+    if (coreDelta != ref->hash || writtenCount == FUZZ_LOG) {
+        fail(data, size, "memory", core, ref);
+    }
+
+    for (int i = 0; i < writtenCount; i++) {
+        core->memory[written[i]] = pristine[written[i]];
+        ref->memory[written[i]] = pristine[written[i]];
+    }
+    return 0;
+}
+
+#ifdef FUZZ_MAIN
+// stand-in for libFuzzer: replays the files given, or runs random inputs
+int main (int argc, char** argv) {
+    uint8_t data[FUZZ_HEADER + FUZZ_CODE];
+    if (argc > 1 && strtoull(argv[1], NULL, 0) == 0) {
+        for (int i = 1; i < argc; i++) {
+            FILE* file = fopen(argv[i], "rb");
+            if (!file) {
+                fprintf(stderr, "Error: Could not open %s\n", argv[i]);
+                return 1;
+            }
+            size_t size = fread(data, 1, sizeof(data), file);
+            fclose(file);
+            LLVMFuzzerTestOneInput(data, size);
+        }
+        return 0;
+    }
+
+    uint64_t iterations = argc > 1 ? strtoull(argv[1], NULL, 0) : 10000000;
+    uint64_t x = (uint64_t) time(NULL) | 1;
+    clock_t start = clock();
+    for (uint64_t n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < sizeof(data); i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            data[i] = (uint8_t) x;
+        }
+        LLVMFuzzerTestOneInput(data, sizeof(data));
+    }
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    fprintf(stderr, "fuzz: %llu inputs, %.0f per second, no divergence\n",
+            (unsigned long long) iterations, seconds > 0 ? iterations / seconds : 0.0);
+    return 0;
+}
+#endif
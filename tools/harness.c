@@ -0,0 +1,102 @@
+#include "harness.h"
+#include "../opcodes.h"
+
+static uint8_t coreIn (i8080* state, uint8_t port) {
+    Ports* ports = state->ioContext;
+    return ports->in[port];
+}
+
+static void coreOut (i8080* state, uint8_t port, uint8_t value) {
+    Ports* ports = state->ioContext;
+    ports->outPort[0] = port;
+    ports->outValue[0] = value;
+}
+
+static uint8_t refIn (RefCpu* cpu, uint8_t port) {
+    Ports* ports = cpu->context;
+    return ports->in[port];
+}
+
+static void refOut (RefCpu* cpu, uint8_t port, uint8_t value) {
+    Ports* ports = cpu->context;
+    ports->outPort[1] = port;
+    ports->outValue[1] = value;
+}
+
+// both cores read ports->in and record their OUTs in it, none seen yet
+void portsConnect (Ports* ports, i8080* state, RefCpu* cpu) {
+    state->portIn = coreIn;
+    state->portOut = coreOut;
+    state->ioContext = ports;
+    cpu->in = refIn;
+    cpu->out = refOut;
+    cpu->context = ports;
+    ports->outPort[0] = ports->outPort[1] = -1;
+}
+
+uint8_t coreFlags (const i8080* state) {
+    return (state->cc.c ? CARRY_MASK : 0) |
+           (state->cc.p ? PARITY_MASK : 0) |
+           (state->cc.ac ? AC_MASK : 0) |
+           (state->cc.z ? ZERO_MASK : 0) |
+           (state->cc.s ? SIGN_MASK : 0) | 0x02;
+}
+
+static uint8_t refBoardIn (RefCpu* cpu, uint8_t port) {
+    RefBoard* board = cpu->context;
+    if (port <= 2) {
+        return board->machine->inputs[port];
+    }
+    return port == 3 ? (uint8_t) (board->shift >> (8 - board->shiftOffset)) : 0;
+}
+
+static void refBoardOut (RefCpu* cpu, uint8_t port, uint8_t value) {
+    RefBoard* board = cpu->context;
+    if (port == 2) {
+        board->shiftOffset = value & 7;
+    }
+    else if (port == 4) {
+        board->shift = (uint16_t) (value << 8 | board->shift >> 8);
+    }
+    else if (port == 3 || port == 5) {
+        board->sound[port == 5] = value;
+    }
+}
+
+// the reference starts from the machine's ports and schedule, at a block start
+void refBoardConnect (RefBoard* board, const Machine* machine, RefCpu* cpu) {
+    board->machine = machine;
+    board->shift = machine->shift;
+    board->shiftOffset = machine->shiftOffset;
+    board->sound[0] = machine->sound[0];
+    board->sound[1] = machine->sound[1];
+    board->interruptAt = machine->interruptAt;
+    board->nextInterrupt = machine->nextInterrupt;
+    board->boundary = true;
+    cpu->in = refBoardIn;
+    cpu->out = refBoardOut;
+    cpu->context = board;
+}
+
+// steps the reference until it has used states, taking the video
+// interrupts on its own schedule at the first block end after they are due,
+// and waiting for them in HLT
+void refBoardRun (RefBoard* board, RefCpu* cpu, uint64_t states) {
+    while (cpu->cycles < states) {
+        if (cpu->halted && cpu->cycles < board->interruptAt) {
+            cpu->cycles = board->interruptAt;
+            continue;
+        }
+        if (board->boundary && cpu->cycles >= board->interruptAt) {
+            refInterrupt(cpu, board->nextInterrupt);
+            board->nextInterrupt = board->nextInterrupt == 1 ? 2 : 1;
+            board->interruptAt += CYCLES_PER_FRAME / 2;
+            continue;
+        }
+        if (cpu->halted) {
+            break;
+        }
+        board->boundary = opcodeTable[cpu->memory[cpu->pc]].flow != FLOW_NONE;
+        refStep(cpu);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../i8080.h"
+#include "../machine.h"
+#include "refcore.h"
+
+// what tools/lockstep.c and tools/fuzz.c share to run a core next to the
+// reference: ports that read the same for both and keep each one's last OUT,
+// the core's flags in the reference's PSW layout, and the Space Invaders
+// board as the reference sees it, for checking the board engines
+
+typedef struct {
+    uint8_t in[256];            // what IN reads, the same for both cores
+    int outPort[2];             // last OUT of the core (0) and the reference (1)
+    uint8_t outValue[2];
+} Ports;
+
+// the board's ports and interrupts for the reference: IN 0-2 read the
+// machine's inputs, which a session changes between blocks, and the shift
+// register, sound latches and interrupt schedule are its own
+typedef struct {
+    const Machine* machine;
+    uint16_t shift;
+    uint8_t shiftOffset;
+    uint8_t sound[2];
+    uint64_t interruptAt;       // the reference's own schedule, as the board's hardware has it
+    int nextInterrupt;
+    bool boundary;              // the last instruction ended a block, where interrupts are taken
+} RefBoard;
+
+void portsConnect (Ports* ports, i8080* state, RefCpu* cpu);
+uint8_t coreFlags (const i8080* state);
+void refBoardConnect (RefBoard* board, const Machine* machine, RefCpu* cpu);
+void refBoardRun (RefBoard* board, RefCpu* cpu, uint64_t states);
+
+static inline bool samePorts (const Ports* ports) {
+    return ports->outPort[0] == ports->outPort[1] && ports->outValue[0] == ports->outValue[1];
+}
+
+static inline bool sameBoardPorts (const RefBoard* board, const Machine* machine) {
+    return machine->shift == board->shift && machine->shiftOffset == board->shiftOffset &&
+           machine->sound[0] == board->sound[0] && machine->sound[1] == board->sound[1];
+}
+
+#endif
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../opcodes.h"
+#include "../i8080.h"
+#include "../machine.h"
+#include "refcore.h"
+#include "harness.h"
+#include "cpm.h"
+
+// runs i8080.c and the reference core in lockstep and stops at the first
+// instruction after which registers, flags, cycles, port output or memory differ.
+// memory is compared through a running hash that both cores update on every
+// store, with a full compare every --full instructions as a backstop
+// usage: lockstep <file> [--org addr] [--count N] [--full N] [--window N] [--in port=value] [--split]
+//        lockstep <rom> --board|--aot [--frames N] [--session file] [--no-idle] [--no-fuse] [--full N] [--window N]
+// .COM files are run as CP/M programs (see cpm.h) with their output on stdout.
+// --split checks splitStep, the core with the board's split flags, instead of opcodeExtract.
+// --board runs the Space Invaders board engine instead (see runBoard), --aot the
+// same with the recompiled rom, in builds with it (make aot-lockstep)
+
+// opcodeExtract with the split flags the board and CP/M cores keep
+#define CORE_STEP splitStep
+#define CORE_SPLIT_FLAGS
+#include "../i8080core.h"
+
+#define WINDOW_MAX 256
+
+typedef struct {
+    uint64_t index;
+    uint16_t pc;
+    uint16_t sp;
+    uint8_t bytes[3];
+    uint8_t a, f, b, c, d, e, h, l;
+} Snapshot;
+
+static uint64_t coreHash;
+static Ports ports;
+static RefBoard refBoard;
+
+static void hashHook (i8080* state, uint16_t address, uint8_t value, int access) {
+    (void) access;
+    coreHash += refHashByte(address, value) - refHashByte(address, state->memory[address]);
+}
+
+static void snapshot (Snapshot* shot, uint64_t index, const i8080* state) {
+    shot->index = index;
+    shot->pc = state->pc;
+    shot->sp = state->sp;
+    for (int i = 0; i < 3; i++) {
+        shot->bytes[i] = state->memory[(uint16_t)(state->pc + i)];
+    }
+    shot->a = state->a;
+    shot->f = coreFlags(state);
+    shot->b = state->b;
+    shot->c = state->c;
+    shot->d = state->d;
+    shot->e = state->e;
+    shot->h = state->h;
+    shot->l = state->l;
+}
+
+static void printSnapshot (const Snapshot* shot) {
+    char text[32];
+    formatInstruction(shot->bytes[0], shot->bytes[1], shot->bytes[2], text, sizeof(text));
+    printf("%10llu  %04X  %-14s A=%02X F=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X SP=%04X\n",
+           (unsigned long long) shot->index, shot->pc, text, shot->a, shot->f,
+           shot->b, shot->c, shot->d, shot->e, shot->h, shot->l, shot->sp);
+}
+
+#define COMPARE(name, core, ref, width) \
+    if ((core) != (ref)) { \
+        printf("  %-6s %0*X  %0*X\n", name, width, (unsigned int) (core), width, (unsigned int) (ref)); \
+        same = false; \
+    }
+
+// prints every field that differs, false if any does
+static bool compare (const i8080* state, const RefCpu* cpu, bool fullMemory) {
+    bool same = true;
+    printf("  field  core reference\n");
+    COMPARE("PC", state->pc, cpu->pc, 4);
+    COMPARE("SP", state->sp, cpu->sp, 4);
+    COMPARE("A", state->a, cpu->reg[REF_A], 2);
+    COMPARE("F", coreFlags(state), cpu->f, 2);
+    COMPARE("B", state->b, cpu->reg[REF_B], 2);
+    COMPARE("C", state->c, cpu->reg[REF_C], 2);
+    COMPARE("D", state->d, cpu->reg[REF_D], 2);
+    COMPARE("E", state->e, cpu->reg[REF_E], 2);
+    COMPARE("H", state->h, cpu->reg[REF_H], 2);
+    COMPARE("L", state->l, cpu->reg[REF_L], 2);
+    COMPARE("IE", state->IE, cpu->ie, 1);
+    COMPARE("HLT", state->halt, cpu->halted, 1);
+    COMPARE("cycles", (uint32_t) state->cycles, (uint32_t) cpu->cycles, 8);
+    COMPARE("port", ports.outPort[0], ports.outPort[1], 2);
+    COMPARE("out", ports.outValue[0], ports.outValue[1], 2);
+    if (coreHash != cpu->hash || fullMemory) {
+        int shown = 0;
+        for (int a = 0; a < MEMORY_SIZE; a++) {
+            if (state->memory[a] != cpu->memory[a] && shown++ < 16) {
+                printf("  [%04X] %02X   %02X\n", a, state->memory[a], cpu->memory[a]);
+                same = false;
+            }
+        }
+        if (coreHash != cpu->hash && !shown) {
+            printf("  memory hash differs but the contents match, a store bypassed writeByte\n");
+            same = false;
+        }
+    }
+    return same;
+}
+
+static inline bool sameRegisters (const i8080* state, const RefCpu* cpu) {
+    return state->pc == cpu->pc && state->sp == cpu->sp && state->a == cpu->reg[REF_A] &&
+           state->b == cpu->reg[REF_B] && state->c == cpu->reg[REF_C] &&
+           state->d == cpu->reg[REF_D] && state->e == cpu->reg[REF_E] &&
+           state->h == cpu->reg[REF_H] && state->l == cpu->reg[REF_L] &&
+           coreFlags(state) == cpu->f && state->IE == cpu->ie && state->halt == cpu->halted &&
+           state->cycles == cpu->cycles;
+}
+
+static inline bool sameState (const i8080* state, const RefCpu* cpu) {
+    return sameRegisters(state, cpu) && coreHash == cpu->hash && samePorts(&ports);
+}
+
+static bool sameBoard (const i8080* state, const RefCpu* cpu, const Machine* machine) {
+    return sameRegisters(state, cpu) && sameBoardPorts(&refBoard, machine);
+}
+
+// prints every board field that differs and the memory, false if any does
+static bool compareBoard (const i8080* state, const RefCpu* cpu, const Machine* machine) {
+    bool same = true;
+    printf("  field  core reference\n");
+    COMPARE("PC", state->pc, cpu->pc, 4);
+    COMPARE("SP", state->sp, cpu->sp, 4);
+    COMPARE("A", state->a, cpu->reg[REF_A], 2);
+    COMPARE("F", coreFlags(state), cpu->f, 2);
+    COMPARE("B", state->b, cpu->reg[REF_B], 2);
+    COMPARE("C", state->c, cpu->reg[REF_C], 2);
+    COMPARE("D", state->d, cpu->reg[REF_D], 2);
+    COMPARE("E", state->e, cpu->reg[REF_E], 2);
+    COMPARE("H", state->h, cpu->reg[REF_H], 2);
+    COMPARE("L", state->l, cpu->reg[REF_L], 2);
+    COMPARE("IE", state->IE, cpu->ie, 1);
+    COMPARE("HLT", state->halt, cpu->halted, 1);
+    COMPARE("cycles", (uint32_t) state->cycles, (uint32_t) cpu->cycles, 8);
+    COMPARE("shift", machine->shift, refBoard.shift, 4);
+    COMPARE("offset", machine->shiftOffset, refBoard.shiftOffset, 1);
+    COMPARE("out 3", machine->sound[0], refBoard.sound[0], 2);
+    COMPARE("out 5", machine->sound[1], refBoard.sound[1], 2);
+    int shown = 0;
+    for (int a = 0; a < MEMORY_SIZE; a++) {
+        if (state->memory[a] != cpu->memory[a] && shown++ < 16) {
+            printf("  [%04X] %02X   %02X\n", a, state->memory[a], cpu->memory[a]);
+            same = false;
+        }
+    }
+    return same;
+}
+
+// --board and --aot: the rom runs on the Space Invaders board (machine.h) one
+// machineRunBlock at a time, as main runs it, so the fused handlers, the
+// wait loop skip and HLT parking are all in play, and with --aot the
+// recompiled blocks, which chain on until an interrupt is due or control
+// leaves them. after each block the reference steps whole instructions until
+// it has used as many states, keeping its own interrupt schedule, so a skip
+// or chain that takes an interrupt anywhere but where the interpreter would
+// diverges. registers, flags, cycles and ports are compared after every
+// block, memory at every interrupt and every full blocks. with --aot a block
+// is all that one aotRunBlock ran, and memory is compared after each
+static int runBoard (i8080* state, RefCpu* cpu, Machine* machine, uint64_t frames, uint64_t full, int window) {
+    refBoardConnect(&refBoard, machine, cpu);
+    Snapshot* trail = calloc(WINDOW_MAX, sizeof(Snapshot));
+    uint64_t n = 0;
+    bool same = true;
+    while (machine->frames < frames && same) {
+        uint64_t due = machine->interruptAt;
+        machineTick(machine, state);
+        bool interrupted = machine->interruptAt != due;
+        if (state->halt) {
+            if (!machineHalt(machine, state)) {
+                fprintf(stderr, "lockstep: halted at %04X with interrupts disabled\n", (uint16_t)(state->pc - 1));
+                break;
+            }
+            continue;
+        }
+
+        snapshot(&trail[n % window], n, state);
+        machineRunBlock(machine, state);
+        syncSplitFlags(state);
+        refBoardRun(&refBoard, cpu, state->cycles);
+
+        bool fullMemory = interrupted || machine->aot || (full && n % full == full - 1);
+        same = sameBoard(state, cpu, machine) &&
+               !(fullMemory && memcmp(state->memory, cpu->memory, MEMORY_SIZE) != 0);
+        n++;
+    }
+    if (!same) {
+        printf("\ndivergence after block %llu, frame %llu\n", (unsigned long long) n - 1,
+               (unsigned long long) machine->frames);
+        compareBoard(state, cpu, machine);
+        printf("last blocks (core state before each):\n");
+        for (uint64_t i = n > (uint64_t) window ? n - window : 0; i < n; i++) {
+            printSnapshot(&trail[i % window]);
+        }
+    }
+    else {
+        fprintf(stderr, "lockstep: %llu blocks, %llu frames, %llu states, no divergence\n",
+                (unsigned long long) n, (unsigned long long) machine->frames, (unsigned long long) state->cycles);
+    }
+    free(trail);
+    return same ? 0 : 1;
+}
+
+int main (int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [--org addr] [--count N] [--full N] [--window N] [--in port=value] [--split]\n"
+                        "       %s <rom> --board|--aot [--frames N] [--session file] [--no-idle] [--no-fuse] [--full N] [--window N]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    bool cpm = cpmIsProgram(argv[1]);
+    uint16_t origin = cpm ? CPM_ORIGIN : 0x0000;
+    uint64_t count = cpm ? 0 : 10000000;
+    uint64_t full = 1 << 20;
+    int window = 16;
+    bool split = false;
+    bool board = false;
+    bool aot = false;
+    bool idle = true;
+    bool fuse = true;
+    uint64_t frames = 600;
+    const char* session = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--org") == 0 && i + 1 < argc) {
+            origin = (uint16_t) strtoul(argv[++i], NULL, 16);
+        }
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--full") == 0 && i + 1 < argc) {
+            full = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
+            window = window < 1 ? 1 : window > WINDOW_MAX ? WINDOW_MAX : window;
+        }
+        else if (strcmp(argv[i], "--split") == 0) {
+            split = true;
+        }
+        else if (strcmp(argv[i], "--board") == 0) {
+            board = true;
+        }
+        else if (strcmp(argv[i], "--aot") == 0) {
+#ifdef I8080_AOT
+            board = aot = true;
+#else
+            fprintf(stderr, "Error: --aot needs the recompiled rom, make aot-lockstep\n");
+            return 1;
+#endif
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+            session = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-idle") == 0) {
+            idle = false;
+        }
+        else if (strcmp(argv[i], "--no-fuse") == 0) {
+            fuse = false;
+        }
+        else if (strcmp(argv[i], "--in") == 0 && i + 1 < argc) {
+            unsigned int port, value;
+            if (sscanf(argv[++i], "%x=%x", &port, &value) == 2) {
+                ports.in[port & 0xff] = (uint8_t) value;
+            }
+        }
+        else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    i8080* state = calloc(1, sizeof(i8080));
+    RefCpu* cpu = calloc(1, sizeof(RefCpu));
+    if (!state || !cpu) {
+        fprintf(stderr, "Error: Could not allocate state\n");
+        return 1;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[1]);
+        return 1;
+    }
+    size_t size = fread(state->memory + origin, 1, MEMORY_SIZE - origin, file);
+    fclose(file);
+
+    initializeState(state);
+    state->pc = origin;
+    if (cpm) {
+        cpmPrepare(state);
+    }
+    memcpy(cpu->memory, state->memory, MEMORY_SIZE);
+    refReset(cpu);
+    cpu->pc = state->pc;
+    cpu->sp = state->sp;
+    cpu->ie = state->IE;
+
+    if (board) {
+        Machine* machine = calloc(1, sizeof(Machine));
+        if (!machine) {
+            fprintf(stderr, "Error: Could not allocate state\n");
+            return 1;
+        }
+        machineInit(machine, state);
+        loadSplitFlags(state);
+        machine->aot = aot;
+        machine->idleSkip = idle;
+        machine->fuse = fuse;
+        if (session && machineLoadSession(machine, session) != 0) {
+            return 1;
+        }
+        fprintf(stderr, "lockstep: %s, %zu bytes on the board%s\n", argv[1], size, aot ? ", recompiled" : "");
+        int result = runBoard(state, cpu, machine, frames, full, window);
+        machineFree(machine);
+        free(machine);
+        free(cpu);
+        free(state);
+        return result;
+    }
+
+    coreHash = refHashMemory(state->memory);
+    state->memoryHook = hashHook;
+    memset(state->pageHooks, PAGE_HOOK_WRITE, sizeof(state->pageHooks));
+    portsConnect(&ports, state, cpu);
+
+    fprintf(stderr, "lockstep: %s, %zu bytes at %04X\n", argv[1], size, origin);
+    Snapshot* trail = calloc(WINDOW_MAX, sizeof(Snapshot));
+    uint64_t n;
+    for (n = 0; !count || n < count; n++) {
+        if (cpm && state->pc == 0x0000) {
+            break;
+        }
+        if (cpm && state->pc == CPM_BDOS) {
+            cpmBdos(state, stdout);
+        }
+        if (state->halt) {
+            fprintf(stderr, "lockstep: halted at %04X\n", (uint16_t)(state->pc - 1));
+            break;
+        }
+
+        snapshot(&trail[n % window], n, state);
+        if (split) {
+            splitStep(state);
+            syncSplitFlags(state);
+        }
+        else {
+            opcodeExtract(state);
+        }
+        refStep(cpu);
+
+        bool fullMemory = full && n % full == full - 1;
+        if (!sameState(state, cpu) || (fullMemory && memcmp(state->memory, cpu->memory, MEMORY_SIZE) != 0)) {
+            printf("\ndivergence after instruction %llu\n", (unsigned long long) n);
+            compare(state, cpu, true);
+            printf("last instructions (core state before each):\n");
+            for (uint64_t i = n + 1 > (uint64_t) window ? n + 1 - window : 0; i <= n; i++) {
+                printSnapshot(&trail[i % window]);
+            }
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "lockstep: %llu instructions, %llu states, no divergence\n",
+            (unsigned long long) n, (unsigned long long) state->cycles);
+    free(trail);
+    free(cpu);
+    free(state);
+    return 0;
+}
@@ -0,0 +1,317 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../opcodes.h"
+#include "../i8080.h"
+#include "../machine.h"
+#include "cpm.h"
+
+// end-to-end workloads: Space Invaders attract mode for a fixed number of
+// frames (headless, no inputs) and the CP/M cpu diagnostics to completion.
+// invaders runs the game's wait loops instruction by instruction, so it
+// measures the core and the block engine; invaders-idle skips them as main
+// does, which leaves nineteen states in twenty unexecuted
+// run from the repository root so the rom and .COM files are found
+// usage: macrobench [--frames N] [--reps N] [--cpu N] [--only name] [--json file]
+//                   [--compare baseline.json] [--threshold percent] [--no-idle] [--no-fuse]
+// with --compare, workloads whose median wall time grew by more than the
+// threshold are flagged and the exit status is 1. --no-idle runs the wait
+// loops in invaders-idle too (see machineRunBlock), --no-fuse
+// runs the game without the fused handlers. built with the recompiled rom
+// (make aot-macrobench) the game runs on it, unless --no-aot
+// a CP/M program ends at a jump to 0000 or at HLT, the game early only at
+// HLT with interrupts disabled
+
+#define REPS_MAX 64
+
+typedef struct {
+    const char* name;
+    const char* path;
+    uint16_t origin;
+    bool cpm;
+    bool idle;              // skip the game's wait loops
+} Workload;
+
+static const Workload workloads[] = {
+    { "invaders", "space-invaders.rom", 0x0000, false, false },
+    { "invaders-idle", "space-invaders.rom", 0x0000, false, true },
+    { "tst8080", "TST8080.COM", CPM_ORIGIN, true, false },
+    { "cputest", "CPUTEST.COM", CPM_ORIGIN, true, false },
+};
+
+#define WORKLOAD_COUNT (int) (sizeof(workloads) / sizeof(workloads[0]))
+
+typedef struct {
+    double wallMin;
+    double wallMedian;
+    uint64_t cycles;
+    uint64_t frames;
+    uint64_t idle;          // states fast-forwarded through wait loops
+    uint32_t checksum;      // of the final memory, must not change between runs
+} Result;
+
+static double now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareDouble (const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t checksum (const uint8_t* memory, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ memory[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool load (i8080* state, const Workload* workload) {
+    FILE* file = fopen(workload->path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", workload->path);
+        return false;
+    }
+    memset(state, 0, sizeof(*state));
+    initializeState(state);
+    fread(state->memory + workload->origin, 1, MEMORY_SIZE - workload->origin, file);
+    fclose(file);
+    if (workload->cpm) {
+        cpmPrepare(state);
+    }
+    return true;
+}
+
+// one timed run; the loops mirror main.c, one basic block per iteration,
+// each on the core specialised for its front end
+static double runOnce (i8080* state, const Workload* workload, uint64_t frames, bool idle, bool fuse, bool aot, Result* result) {
+    Machine machine;
+    double start;
+    if (workload->cpm) {
+        start = now();
+        while (state->pc != 0x0000 && !state->halt) {     // nothing wakes a halted diagnostic
+            if (state->pc == CPM_BDOS) {
+                cpmBdos(state, NULL);
+            }
+            cpmRunBlock(state);
+        }
+    }
+    else {
+        machineInit(&machine, state);
+        machine.idleSkip = idle;
+        machine.fuse = fuse;
+        machine.aot = aot;
+        start = now();
+        // ends at the interrupt that closes the last frame, so every engine
+        // stops at the same state however many blocks a call runs
+        for (;;) {
+            machineTick(&machine, state);
+            if (machine.frames >= frames) {
+                break;
+            }
+            if (state->halt) {
+                if (!machineHalt(&machine, state)) {
+                    break;
+                }
+                continue;
+            }
+            machineRunBlock(&machine, state);
+        }
+        result->frames = machine.frames;
+        result->idle = machine.idleSkipped;
+    }
+    double wall = now() - start;
+    result->cycles = state->cycles;
+    result->checksum = checksum(state->memory, MEMORY_SIZE);
+    return wall;
+}
+
+static bool runWorkload (const Workload* workload, uint64_t frames, int reps, bool idle, bool fuse, bool aot, Result* result) {
+    static i8080 state;
+    double walls[REPS_MAX];
+    memset(result, 0, sizeof(*result));
+    for (int r = -1; r < reps; r++) {       // run -1 is the warm-up
+        if (!load(&state, workload)) {
+            return false;
+        }
+        uint32_t previous = result->checksum;
+        double wall = runOnce(&state, workload, frames, idle, fuse, aot, result);
+        if (r > 0 && result->checksum != previous) {
+            fprintf(stderr, "Error: %s is not deterministic\n", workload->name);
+        }
+        if (r >= 0) {
+            walls[r] = wall;
+        }
+    }
+    qsort(walls, reps, sizeof(double), compareDouble);
+    result->wallMin = walls[0];
+    result->wallMedian = reps % 2 ? walls[reps / 2] : (walls[reps / 2 - 1] + walls[reps / 2]) / 2;
+    return true;
+}
+
+// finds "wall_median" of the named workload in a file written by --json
+static double baselineMedian (const char* text, const char* name) {
+    char key[64];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    const char* entry = strstr(text, key);
+    const char* field = entry ? strstr(entry, "\"wall_median\":") : NULL;
+    return field ? atof(field + strlen("\"wall_median\":")) : 0;
+}
+
+static char* readFile (const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = calloc(1, size + 1);
+    if (text && fread(text, 1, size, file) != (size_t) size) {
+        free(text);
+        text = NULL;
+    }
+    fclose(file);
+    return text;
+}
+
+static void pin (int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "warning: could not pin to cpu %d\n", cpu);
+    }
+#endif
+}
+
+int main (int argc, char** argv) {
+    uint64_t frames = 600;
+    int reps = 5;
+    int cpu = 0;
+    const char* only = NULL;
+    const char* json = NULL;
+    const char* baseline = NULL;
+    double threshold = 5.0;
+    bool idle = true;
+    bool fuse = true;
+    bool aot = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--no-idle") == 0) {
+            idle = false;
+        }
+        else if (strcmp(argv[i], "--no-fuse") == 0) {
+            fuse = false;
+        }
+#ifdef I8080_AOT
+        else if (strcmp(argv[i], "--no-aot") == 0) {
+            aot = false;
+        }
+#endif
+        else {
+            fprintf(stderr, "usage: %s [--frames N] [--reps N] [--cpu N] [--only name] [--json file]\n"
+                            "       [--compare baseline.json] [--threshold percent] [--no-idle] [--no-fuse]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1 || reps > REPS_MAX) {
+        fprintf(stderr, "Error: --reps must be between 1 and %d\n", REPS_MAX);
+        return 1;
+    }
+
+    char* base = NULL;
+    if (baseline && !(base = readFile(baseline))) {
+        fprintf(stderr, "Error: Could not read %s\n", baseline);
+        return 1;
+    }
+    FILE* out = NULL;
+    if (json && !(out = fopen(json, "w"))) {
+        fprintf(stderr, "Error: Could not open %s\n", json);
+        return 1;
+    }
+    if (out) {
+#ifdef I8080_AOT
+        const char* engine = aot ? "aot" : "interpreter";
+#else
+        const char* engine = "interpreter";
+#endif
+        fprintf(out, "{\n  \"engine\": \"%s\",\n  \"idle_skip\": %s,\n  \"fusion\": %s,\n  \"frames\": %llu,\n  \"reps\": %d,\n  \"workloads\": [",
+                engine, idle ? "true" : "false", fuse ? "true" : "false", (unsigned long long) frames, reps);
+    }
+
+    pin(cpu);
+    int regressions = 0;
+    bool first = true;
+    printf("%-13s %10s %10s %10s %10s %10s\n", "workload", "min s", "median s", "MHz", "frames/s", "vs base");
+    for (int w = 0; w < WORKLOAD_COUNT; w++) {
+        const Workload* workload = &workloads[w];
+        Result result;
+        bool skip = idle && workload->idle;
+        if ((only && strcmp(only, workload->name) != 0) || !runWorkload(workload, frames, reps, skip, fuse, aot, &result)) {
+            continue;
+        }
+        double mhz = result.cycles / result.wallMedian / 1e6;
+        double fps = result.frames / result.wallMedian;
+        printf("%-13s %10.4f %10.4f %10.1f %10.1f", workload->name, result.wallMin, result.wallMedian,
+               mhz, workload->cpm ? 0.0 : fps);
+
+        double before = base ? baselineMedian(base, workload->name) : 0;
+        if (before > 0) {
+            double change = (result.wallMedian / before - 1) * 100;
+            bool regressed = change > threshold;
+            regressions += regressed;
+            printf(" %+9.1f%%%s", change, regressed ? "  REGRESSION" : "");
+        }
+        printf("\n");
+
+        if (out) {
+            fprintf(out, "%s\n    { \"name\": \"%s\", \"wall_min\": %.6f, \"wall_median\": %.6f, \"states\": %llu, "
+                         "\"mhz\": %.2f, \"frames\": %llu, \"fps\": %.2f, \"idle_states\": %llu, \"checksum\": \"%08x\" }",
+                    first ? "" : ",", workload->name, result.wallMin, result.wallMedian,
+                    (unsigned long long) result.cycles, mhz, (unsigned long long) result.frames,
+                    workload->cpm ? 0.0 : fps, (unsigned long long) result.idle, result.checksum);
+        }
+        first = false;
+    }
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+    free(base);
+    if (regressions) {
+        printf("%d workload(s) regressed by more than %.1f%%\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
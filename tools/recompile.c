@@ -0,0 +1,685 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../opcodes.h"
+#include "../cfg.h"
+#include "../machine.h"
+#include "../aot.h"
+
+// ahead-of-time recompiler for the Space Invaders rom: finds the basic blocks
+// reachable from reset and the RST vectors (cfg.c) and writes them out as C,
+// one case of aotRunBlock (aot.h) per block. The output is built into the
+// emulator with -DI8080_AOT (make aot); blocks it does not cover, such as
+// PCHL targets not given with --entry, still run on the interpreter.
+//
+// Blocks are chained: a jump, call or RST to a compiled block, and the
+// fall-through of a conditional, is a goto to its label, and a RET or PCHL
+// that is not predicted (below) goes back round the switch. So aotRunBlock
+// only returns when the budget it is given runs out (checked on every edge,
+// so interrupts are taken at the same instruction as the interpreter's), at
+// HLT, after a store into the rom, or at an address with no compiled block.
+// A wait loop, a block without side effects that jumps back to itself, is
+// never chained into or out of: it only runs first, alone, so
+// machineRunBlock can see it and skip the wait.
+//
+// RET is predicted: each linked call pushes the id of the block it returns
+// to on a small ring kept by the caller, and RET pops one and goes straight
+// there when the pc it popped is that block's, else round the switch. Each
+// PCHL keeps the targets it has jumped to with their labels (a gcc
+// extension) and goes straight to one it has seen before. It needs no list
+// of them: a target with no compiled block, as handlers read from a table
+// are unless given with --entry, goes round the switch to the interpreter.
+// usage: recompile <rom> <out.c> [--entry addr]...
+//
+// Each instruction becomes the statement its case in i8080core.h runs, with
+// the operands filled in, on an instance of the core that keeps its names
+// (CORE_KEEP_NAMES). pc is only written before the last instruction, which
+// is the only one that reads it, and the cycles of a block are added in one
+// go, so the state a block leaves is exactly the interpreter's. A backward
+// pass over each block finds flags that are written again before anything
+// reads them; instructions whose results are partly dead that way are
+// written out without those flag updates (emitTrimmed).
+
+#define ENTRY_MAX 64
+#define BLOCK_MAX 1024      // instructions, more than a block of the rom can hold
+
+// the split flag core keeps S, Z and P as one result byte, so they live and die together
+#define FLAGS_SZP (SIGN_MASK | ZERO_MASK | PARITY_MASK)
+
+static uint8_t memory[65536];
+
+static const char* registers[8] = {
+    "state->b", "state->c", "state->d", "state->e", "state->h", "state->l", NULL, "state->a"
+};
+static const char* pairs[4] = { "state->bc", "state->de", "state->hl", "state->sp" };
+static const char* alu[8] = { "add", "addC", "sub", "subC", "ana", "xra", "ora", "cmp" };
+static const char* flows[] = {
+    "FLOW_NONE", "FLOW_JUMP", "FLOW_JUMP_COND", "FLOW_CALL", "FLOW_CALL_COND",
+    "FLOW_RET", "FLOW_RET_COND", "FLOW_RST", "FLOW_PCHL", "FLOW_HALT"
+};
+
+// condition of Jcc/Ccc/Rcc: the flag, and whether the branch is taken when it is set
+static const char* conditionFlag[8] = { "FLAG_Z", "FLAG_Z", "FLAG_C", "FLAG_C", "FLAG_P", "FLAG_P", "FLAG_S", "FLAG_S" };
+
+// register or (HL) operand in the low three bits, as an expression
+static void source (char* out, size_t size, int field) {
+    snprintf(out, size, "%s", field == 6 ? "CORE_READ(state, state->hl)" : registers[field]);
+}
+
+static int trimmed;         // instructions written without some of their flags
+
+// PCHLs given a target cache, numbered from 0 in block order; the others
+// go round the switch
+static int pchlSites;
+
+// return sites: the linked block after each call, numbered from 1 for the
+// return address ring, 0 where there is none
+static uint16_t returnIds[ROM_SIZE];
+static uint16_t returnSites[ROM_SIZE];
+static int returnCount;
+
+// appends printf output to code
+static void append (char* code, size_t size, const char* format, ...) {
+    size_t used = strlen(code);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(code + used, size - used, format, args);
+    va_end(args);
+}
+
+// flag updates of an 8-bit result in temp, only those in need
+static void appendFlags (char* code, size_t size, uint8_t need, const char* carry, const char* aux) {
+    if (need & FLAGS_SZP) {
+        append(code, size, "SET_SZP(state, temp);\n        ");
+    }
+    if ((need & CARRY_MASK) && carry) {
+        append(code, size, "SET_C(state, %s);\n        ", carry);
+    }
+    if ((need & AC_MASK) && aux) {
+        append(code, size, "%s;\n        ", aux);
+    }
+}
+
+// the instruction at pc with only the flags in need produced, for one that
+// writes others no later instruction reads. false when it has no such form
+// (DAA, POP PSW) and is written out whole
+static bool emitTrimmed (char* code, size_t size, uint16_t pc, uint8_t need) {
+    uint8_t op = memory[pc];
+    uint8_t byte = memory[pc + 1];
+    int field = (op >> 3) & 7;
+    char value[32];
+    char text[128];
+
+    if ((op >= 0x80 && op < 0xC0) || (op & 0xC7) == 0xC6) {    // ADD .. CMP, ADI .. CPI
+        if (op >= 0xC0) {
+            snprintf(value, sizeof(value), "0x%02X", byte);
+        }
+        else if ((op & 7) == 6) {
+            append(code, size, "m = CORE_READ(state, state->hl);\n        ");
+            snprintf(value, sizeof(value), "m");
+        }
+        else {
+            snprintf(value, sizeof(value), "%s", registers[op & 7]);
+        }
+        static const char* operators[8] = { "+", "+", "-", "-", "&", "^", "|", "-" };
+        append(code, size, "temp = state->a %s %s%s;\n        ", operators[field], value,
+               field == 1 ? " + FLAG_C(state)" : field == 3 ? " - FLAG_C(state)" : "");
+        switch (field) {
+            case 0:
+            case 1:
+                snprintf(text, sizeof(text), "SET_AC_ADD(state, state->a, %s, temp)", value);
+                appendFlags(code, size, need, "temp > 0xff", text);
+                break;
+            case 2:
+            case 3:
+                snprintf(text, sizeof(text), "SET_AC_SUB(state, state->a, %s, temp)", value);
+                appendFlags(code, size, need, "temp > 0xff", text);
+                break;
+            case 4:
+                snprintf(text, sizeof(text), "SET_AC(state, ((state->a | %s) & 0x08) != 0)", value);
+                appendFlags(code, size, need, "0", text);
+                break;
+            case 5:
+            case 6:
+                appendFlags(code, size, need, "0", "SET_AC(state, 0)");
+                break;
+            default: {
+                char carry[48];
+                snprintf(carry, sizeof(carry), "state->a < %s", value);
+                snprintf(text, sizeof(text), "SET_AC_SUB(state, state->a, %s, temp)", value);
+                appendFlags(code, size, need, carry, text);
+                break;
+            }
+        }
+        if (field != 7) {
+            append(code, size, "state->a = temp;");
+        }
+    }
+    else if ((op & 0xC7) == 0x04 || (op & 0xC7) == 0x05) {     // INR, DCR
+        const char* target = field == 6 ? "m" : registers[field];
+        if (field == 6) {
+            append(code, size, "m = CORE_READ(state, state->hl);\n        ");
+        }
+        append(code, size, "temp = %s %s 1;\n        ", target, (op & 1) ? "-" : "+");
+        snprintf(text, sizeof(text), "SET_AC_%s(state, %s, 1, temp)", (op & 1) ? "SUB" : "ADD", target);
+        appendFlags(code, size, need, NULL, text);
+        if (field == 6) {
+            append(code, size, "CORE_WRITE(state, state->hl, temp);");
+        }
+        else {
+            append(code, size, "%s = temp;", target);
+        }
+    }
+    else if ((op & 0xCF) == 0x09) {                             // DAD, carry dead
+        append(code, size, "state->hl += %s;", pairs[(op >> 4) & 3]);
+    }
+    else {
+        switch (op) {                                           // carry dead
+            case 0x07: append(code, size, "state->a = (state->a << 1) | (state->a >> 7);"); break;
+            case 0x0F: append(code, size, "state->a = (state->a >> 1) | (state->a << 7);"); break;
+            case 0x17: append(code, size, "state->a = (state->a << 1) | FLAG_C(state);"); break;
+            case 0x1F: append(code, size, "state->a = (state->a >> 1) | (FLAG_C(state) << 7);"); break;
+            case 0x37:
+            case 0x3F: break;
+            default: return false;
+        }
+    }
+    // no trailing separator when the last flag update ends it
+    size_t length = strlen(code);
+    while (length && (code[length - 1] == ' ' || code[length - 1] == '\n')) {
+        code[--length] = '\0';
+    }
+    trimmed++;
+    return true;
+}
+
+// the statements of the instruction at pc, all of its flags produced
+static void wholeInstruction (char* code, size_t size, uint16_t pc) {
+    uint8_t op = memory[pc];
+    uint8_t byte = memory[pc + 1];
+    uint16_t word = memory[pc + 1] | (memory[pc + 2] << 8);
+    int dst = (op >> 3) & 7;
+    int pair = (op >> 4) & 3;
+    bool set = (op >> 3) & 1;
+    char operand[48];
+
+    if (op >= 0x40 && op < 0x80 && op != 0x76) {         // MOV
+        source(operand, sizeof(operand), op & 7);
+        if (dst == 6) {
+            snprintf(code, size, "CORE_WRITE(state, state->hl, %s);", operand);
+        }
+        else {
+            snprintf(code, size, "%s = %s;", registers[dst], operand);
+        }
+    }
+    else if (op >= 0x80 && op < 0xC0) {                    // ADD .. CMP
+        source(operand, sizeof(operand), op & 7);
+        snprintf(code, size, "%s(state, %s);", alu[dst], operand);
+    }
+    else if ((op & 0xC7) == 0x04 || (op & 0xC7) == 0x05) { // INR, DCR
+        const char* name = (op & 1) ? "dcr" : "inr";
+        if (dst == 6) {
+            snprintf(code, size, "m = CORE_READ(state, state->hl);\n        %s(state, &m);\n"
+                     "        CORE_WRITE(state, state->hl, m);", name);
+        }
+        else {
+            snprintf(code, size, "%s(state, &%s);", name, registers[dst]);
+        }
+    }
+    else if ((op & 0xC7) == 0x06) {                        // MVI
+        if (dst == 6) {
+            snprintf(code, size, "CORE_WRITE(state, state->hl, 0x%02X);", byte);
+        }
+        else {
+            snprintf(code, size, "%s = 0x%02X;", registers[dst], byte);
+        }
+    }
+    else if ((op & 0xC7) == 0xC6) {                        // ADI .. CPI
+        snprintf(code, size, "%s(state, 0x%02X);", op == 0xE6 ? "anaI" : alu[dst], byte);
+    }
+    else if ((op & 0xC7) == 0xC2) {                        // Jcc
+        snprintf(code, size, "%s(state, %s(state), 0x%04X);", set ? "jx" : "jnx", conditionFlag[dst], word);
+    }
+    else if ((op & 0xC7) == 0xC4) {                        // Ccc
+        snprintf(code, size, "%s(state, %s(state), &state->memory[0x%04X], 0x%04X);",
+                 set ? "cx" : "cnx", conditionFlag[dst], pc, word);
+    }
+    else if ((op & 0xC7) == 0xC0) {                        // Rcc
+        snprintf(code, size, "%s(state, %s(state), &state->memory[0x%04X]);",
+                 set ? "rx" : "rnx", conditionFlag[dst], pc);
+    }
+    else if ((op & 0xC7) == 0xC7) {                        // RST
+        snprintf(code, size, "rst(state, 0x%04X);", op & 0x38);
+    }
+    else if ((op & 0xCF) == 0x01) {                        // LXI
+        snprintf(code, size, "%s = 0x%04X;", pairs[pair], word);
+    }
+    else if ((op & 0xCF) == 0x03) {                        // INX
+        snprintf(code, size, "%s += 1;", pairs[pair]);
+    }
+    else if ((op & 0xCF) == 0x0B) {                        // DCX
+        snprintf(code, size, "%s -= 1;", pairs[pair]);
+    }
+    else if ((op & 0xCF) == 0x09) {                        // DAD
+        snprintf(code, size, "dad(state, %s);", pairs[pair]);
+    }
+    else if ((op & 0xCF) == 0xC1 && op != 0xF1) {         // POP
+        snprintf(code, size, "pop(state, &%s);", pairs[pair]);
+    }
+    else if ((op & 0xCF) == 0xC5 && op != 0xF5) {         // PUSH
+        snprintf(code, size, "push(state, %s);", pairs[pair]);
+    }
+    else {
+        switch (op) {
+            case 0x02: snprintf(code, size, "stax(state, state->bc);"); break;
+            case 0x12: snprintf(code, size, "stax(state, state->de);"); break;
+            case 0x0A: snprintf(code, size, "ldax(state, state->bc);"); break;
+            case 0x1A: snprintf(code, size, "ldax(state, state->de);"); break;
+            case 0x07: snprintf(code, size, "rlc(state);"); break;
+            case 0x0F: snprintf(code, size, "rrc(state);"); break;
+            case 0x17: snprintf(code, size, "ral(state);"); break;
+            case 0x1F: snprintf(code, size, "rar(state);"); break;
+            case 0x22: snprintf(code, size, "shld(state, 0x%04X);", word); break;
+            case 0x2A: snprintf(code, size, "lhld(state, 0x%04X);", word); break;
+            case 0x32: snprintf(code, size, "sta(state, 0x%04X);", word); break;
+            case 0x3A: snprintf(code, size, "lda(state, 0x%04X);", word); break;
+            case 0x27: snprintf(code, size, "daa(state);"); break;
+            case 0x2F: snprintf(code, size, "state->a = ~state->a;"); break;
+            case 0x37: snprintf(code, size, "SET_C(state, 1);"); break;
+            case 0x3F: snprintf(code, size, "SET_C(state, !FLAG_C(state));"); break;
+            case 0x76: snprintf(code, size, "state->halt = 1;"); break;
+            case 0xC3:
+            case 0xCB: snprintf(code, size, "state->pc = 0x%04X;", word); break;
+            case 0xCD:
+            case 0xDD:
+            case 0xED:
+            case 0xFD: snprintf(code, size, "call(state, 0x%04X);", word); break;
+            case 0xC9:
+            case 0xD9: snprintf(code, size, "ret(state);"); break;
+            case 0xD3: snprintf(code, size, "CORE_OUT(state, 0x%02X, state->a);", byte); break;
+            case 0xDB: snprintf(code, size, "state->a = CORE_IN(state, 0x%02X);", byte); break;
+            case 0xE3:
+                snprintf(code, size, "temp = (CORE_READ(state, (uint16_t)(state->sp+1))<<8) | CORE_READ(state, state->sp);\n"
+                         "        CORE_WRITE(state, state->sp, state->l);\n"
+                         "        CORE_WRITE(state, (uint16_t)(state->sp+1), state->h);\n"
+                         "        state->hl = temp;");
+                break;
+            case 0xE9: snprintf(code, size, "state->pc = state->hl;"); break;
+            case 0xEB: snprintf(code, size, "temp = state->de;\n        state->de = state->hl;\n        state->hl = temp;"); break;
+            case 0xF1: snprintf(code, size, "popPSW(state);"); break;
+            case 0xF5: snprintf(code, size, "pushPSW(state);"); break;
+            case 0xF3: snprintf(code, size, "state->IE = 0;"); break;
+            case 0xFB: snprintf(code, size, "state->IE = 1;"); break;
+            case 0xF9: snprintf(code, size, "state->sp = state->hl;"); break;
+            default: break;       // NOP and its aliases
+        }
+    }
+
+}
+
+// one instruction's statements, with its disassembly as the comment; live
+// is the flags a later instruction may read
+static void emitInstruction (FILE* out, uint16_t pc, uint8_t live) {
+    uint8_t op = memory[pc];
+    char code[320] = "";
+    uint8_t need = opcodeTable[op].flags & live;
+    if (need & FLAGS_SZP) {
+        need |= opcodeTable[op].flags & FLAGS_SZP;
+    }
+    if (need == opcodeTable[op].flags || !emitTrimmed(code, sizeof(code), pc, need)) {
+        wholeInstruction(code, sizeof(code), pc);
+    }
+
+    // the comment goes after the last line of several
+    char text[32];
+    formatInstruction(op, memory[pc + 1], memory[pc + 2], text, sizeof(text));
+    char* last = strrchr(code, '\n');
+    if (last) {
+        *last = '\0';
+        fprintf(out, "        %s\n", code);
+        last += strspn(last + 1, " ") + 1;
+    }
+    fprintf(out, "        %-48s// %04X %s\n", last ? last : code, pc, text);
+}
+
+// a store that can land below ROM_SIZE may rewrite code compiled from it;
+// STA and SHLD with a ram address cannot
+static bool mayStoreRom (uint16_t pc) {
+    uint8_t op = memory[pc];
+    uint16_t word = memory[pc + 1] | (memory[pc + 2] << 8);
+    if (!(opcodeTable[op].effects & EFFECT_STORE)) {
+        return false;
+    }
+    if (op == 0x32) {
+        return word < ROM_SIZE;
+    }
+    if (op == 0x22) {
+        return word < ROM_SIZE || (uint16_t)(word + 1) < ROM_SIZE;
+    }
+    return true;
+}
+
+// flags each instruction of the block must still produce, by index. all of
+// them are live where the block ends, since the next block or an interrupt
+// handler may read any, and after a store that can send the block back to
+// the interpreter; interrupts are not taken anywhere else
+static void flagLiveness (const CfgBlock* block, uint8_t* live) {
+    uint16_t pcs[BLOCK_MAX];
+    int count = 0;
+    for (uint32_t pc = block->start; pc < block->end && count < BLOCK_MAX; pc += opcodeTable[memory[pc]].length) {
+        pcs[count++] = pc;
+    }
+    uint8_t after = FLAGS_ALL;
+    for (int i = count - 1; i >= 0; i--) {
+        uint8_t op = memory[pcs[i]];
+        if (i != count - 1 && mayStoreRom(pcs[i])) {
+            after = FLAGS_ALL;
+        }
+        live[i] = after;
+        after = (after & ~opcodeTable[op].flags) | opcodeFlagsRead(op);
+    }
+}
+
+// as idleBody in machine.c: nothing in the block stores, touches a port or
+// changes the interrupt enable
+static bool effectFree (const CfgBlock* block) {
+    for (uint32_t pc = block->start; pc < block->end; pc += opcodeTable[memory[pc]].length) {
+        if (opcodeTable[memory[pc]].effects) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool waitLoop (const CfgBlock* block) {
+    return (block->target == block->start || block->next == block->start) && effectFree(block);
+}
+
+// whether the edge to address becomes a goto
+static bool linked (const Cfg* cfg, int32_t address) {
+    const CfgBlock* block = address == CFG_NONE ? NULL : cfgBlockAt(cfg, address);
+    return block && !waitLoop(block);
+}
+
+// the goto to a linked block; a call first pushes the id of the site its
+// RET comes back to, when that site has one
+static void emitGoto (FILE* out, const CfgBlock* block, int32_t address, const char* indent) {
+    bool calls = block->flow == FLOW_CALL || block->flow == FLOW_CALL_COND || block->flow == FLOW_RST;
+    if (calls && address == block->target && returnIds[block->next]) {
+        fprintf(out, "%saotPush(cache, %u);\n", indent, returnIds[block->next]);
+    }
+    fprintf(out, "%sgoto block_%04X;\n", indent, address);
+}
+
+// what follows the last instruction, which has left the successor in pc.
+// jumps, calls and RSTs have one static successor and conditional jumps
+// and calls two, so the last of them needs no compare. RET tries the return
+// site the matching call pushed, PCHL the targets its site has cached, and
+// what is left, edges out of the compiled code among it, goes round the
+// switch; edges to a wait loop return
+static void emitExit (FILE* out, const Cfg* cfg, const CfgBlock* block) {
+    if (block->flow == FLOW_HALT) {
+        fprintf(out, "        *from = 0x%04X;\n", block->start);
+        fprintf(out, "        return FLOW_HALT;\n");
+        return;
+    }
+    fprintf(out, "        if (state->cycles >= budget%s) {\n", mayStoreRom(block->last) ? " || state->trap" : "");
+    fprintf(out, "            *from = 0x%04X;\n", block->start);
+    fprintf(out, "            return %s;\n", flows[block->flow]);
+    fprintf(out, "        }\n");
+
+    // a CALL or RST returns to next, but that is another block's business
+    bool calls = block->flow == FLOW_CALL || block->flow == FLOW_RST;
+    int32_t successors[2] = { block->target, calls ? CFG_NONE : block->next };
+    bool known = block->flow != FLOW_RET_COND && block->flow != FLOW_RET && block->flow != FLOW_PCHL;
+    for (int i = 0; i < 2; i++) {
+        int32_t address = successors[i];
+        bool last = i == 1 || successors[1] == CFG_NONE;
+        if (address == CFG_NONE) {
+            continue;
+        }
+        if (linked(cfg, address) && known && last) {
+            emitGoto(out, block, address, "        ");
+            return;
+        }
+        if (linked(cfg, address)) {
+            fprintf(out, "        if (state->pc == 0x%04X) {\n", address);
+            emitGoto(out, block, address, "            ");
+            fprintf(out, "        }\n");
+        }
+        else if (cfgBlockAt(cfg, address)) {
+            fprintf(out, "        if (state->pc == 0x%04X) {\n", address);
+            fprintf(out, "            *from = 0x%04X;\n", block->start);
+            fprintf(out, "            return %s;\n", flows[block->flow]);
+            fprintf(out, "        }\n");
+        }
+    }
+    bool cached = block->flow == FLOW_PCHL && pchlSites < AOT_PCHL_SITES;
+    if (cached) {
+        fprintf(out, "        for (int i = 0; i < cache->pchlCount[%d]; i++) {\n", pchlSites);
+        fprintf(out, "            if (state->pc == cache->pchlTargets[%d][i]) {\n", pchlSites);
+        fprintf(out, "                goto *cache->pchlLabels[%d][i];\n", pchlSites);
+        fprintf(out, "            }\n        }\n");
+        fprintf(out, "        site = %d;\n", pchlSites++);
+    }
+    fprintf(out, "        *from = 0x%04X;\n", block->start);
+    fprintf(out, "        last = %s;\n", flows[block->flow]);
+    bool returns = block->flow == FLOW_RET || block->flow == FLOW_RET_COND;
+    fprintf(out, "        goto %s;\n", returns ? "predict" : cached ? "pchl" : "dispatch");
+}
+
+// the PCHL target cache (AotCache): a PCHL whose pc is not among the
+// targets its site has cached ends up here with the site in site, and
+// looks the pc up among the linked blocks. a compiled one replaces the
+// oldest target, once the site's ways are full, and is jumped to; anything
+// else goes round the switch, as it always does with no cache
+static void emitTargets (FILE* out, const Cfg* cfg, int targets) {
+    fprintf(out, "    int site = 0;               // PCHL of a cache miss\n");
+    fprintf(out, "    static const uint16_t targets[%d] = {", targets);
+    int i = 0;
+    for (uint32_t address = 0; address < ROM_SIZE; address++) {
+        if (linked(cfg, address)) {
+            fprintf(out, "%s0x%04X,", i++ % 8 ? " " : "\n        ", address);
+        }
+    }
+    fprintf(out, "\n    };\n");
+    fprintf(out, "    static void* const targetLabels[%d] = {", targets);
+    i = 0;
+    for (uint32_t address = 0; address < ROM_SIZE; address++) {
+        if (linked(cfg, address)) {
+            fprintf(out, "%s&&block_%04X,", i++ % 4 ? " " : "\n        ", address);
+        }
+    }
+    fprintf(out, "\n    };\n");
+    fprintf(out, "    goto dispatch;\n");
+    fprintf(out, "pchl:\n");
+    fprintf(out, "    for (int low = 0, high = %d; low < high; ) {\n", targets);
+    fprintf(out, "        int middle = (low + high) / 2;\n");
+    fprintf(out, "        if (targets[middle] < state->pc) {\n");
+    fprintf(out, "            low = middle + 1;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "        else if (targets[middle] > state->pc) {\n");
+    fprintf(out, "            high = middle;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "        else {\n");
+    fprintf(out, "            int way = cache->pchlNext[site]++ %% AOT_PCHL_WAYS;\n");
+    fprintf(out, "            cache->pchlCount[site] += cache->pchlCount[site] < AOT_PCHL_WAYS;\n");
+    fprintf(out, "            cache->pchlTargets[site][way] = state->pc;\n");
+    fprintf(out, "            cache->pchlLabels[site][way] = targetLabels[middle];\n");
+    fprintf(out, "            goto *targetLabels[middle];\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+}
+
+static void emitBlock (FILE* out, const Cfg* cfg, const CfgBlock* block, const bool* labels) {
+    fprintf(out, "    case 0x%04X:\n", block->start);
+    if (labels[block->start]) {
+        fprintf(out, "    block_%04X:\n", block->start);
+    }
+    if (waitLoop(block)) {
+        fprintf(out, "        if (last) {\n            return last;\n        }\n");
+    }
+    uint8_t live[BLOCK_MAX];
+    flagLiveness(block, live);
+    uint32_t pending = 0;
+    int i = 0;
+    for (uint32_t pc = block->start; pc < block->end; pc += opcodeTable[memory[pc]].length, i++) {
+        pending += opcodeTable[memory[pc]].cycles;
+        if (pc == block->last) {
+            fprintf(out, "        state->cycles += %u;\n", pending);
+            fprintf(out, "        state->pc = 0x%04X;\n", block->end & 0xFFFF);
+            emitInstruction(out, pc, live[i]);
+            break;
+        }
+        emitInstruction(out, pc, live[i]);
+        if (pc != block->last && mayStoreRom(pc)) {
+            // the interpreter finishes the block from the next instruction
+            uint16_t next = pc + opcodeTable[memory[pc]].length;
+            fprintf(out, "        if (state->trap) {\n");
+            fprintf(out, "            state->cycles += %u;\n", pending);
+            fprintf(out, "            state->pc = 0x%04X;\n", next);
+            fprintf(out, "            *from = 0x%04X;\n", block->start);
+            fprintf(out, "            return FLOW_NONE;\n");
+            fprintf(out, "        }\n");
+        }
+    }
+    emitExit(out, cfg, block);
+}
+
+int main (int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <rom> <out.c> [--entry addr]...\n", argv[0]);
+        return 1;
+    }
+    uint16_t entries[ENTRY_MAX];
+    int entryCount = 0;
+    for (int v = 0; v < 8; v++) {           // reset is RST 0
+        entries[entryCount++] = v * 8;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc && entryCount < ENTRY_MAX) {
+            entries[entryCount++] = (uint16_t) strtoul(argv[++i], NULL, 16);
+        }
+        else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[1]);
+        return 1;
+    }
+    size_t size = fread(memory, 1, ROM_SIZE, file);
+    fclose(file);
+
+    Cfg cfg;
+    if (cfgBuild(&cfg, memory, ROM_SIZE, entries, entryCount) != 0) {
+        return 1;
+    }
+    FILE* out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[2]);
+        cfgFree(&cfg);
+        return 1;
+    }
+
+    int instructions = 0;
+    for (int i = 0; i < cfg.count; i++) {
+        instructions += cfg.blocks[i].count;
+    }
+    fprintf(out, "// generated by tools/recompile.c from %s (%zu bytes), do not edit\n", argv[1], size);
+    fprintf(out, "// %d blocks, %d instructions\n\n", cfg.count, instructions);
+    fprintf(out, "#include \"machine.h\"\n#include \"aot.h\"\n\n");
+    fprintf(out, "// stores into the rom end the block, see aot.h\n");
+    fprintf(out, "static inline void aotWrite (i8080* state, uint16_t address, uint8_t value) {\n");
+    fprintf(out, "    if (address < ROM_SIZE) {\n        state->trap = true;\n    }\n");
+    fprintf(out, "    state->memory[address] = value;\n}\n\n");
+    fprintf(out, "#define CORE_STEP aotStep\n");
+    fprintf(out, "#define CORE_READ(state, address) ((state)->memory[address])\n");
+    fprintf(out, "#define CORE_WRITE(state, address, value) aotWrite(state, address, value)\n");
+    fprintf(out, "#define CORE_TRAP(state) 0\n");
+    fprintf(out, "#define CORE_SHADOW_CALL(state, entry, ret)\n");
+    fprintf(out, "#define CORE_SHADOW_RET(state, ret)\n");
+    fprintf(out, "#define CORE_SPLIT_FLAGS\n");
+    fprintf(out, "#define CORE_KEEP_NAMES\n");
+    fprintf(out, "#include \"i8080core.h\"\n\n");
+    // labels only where a goto lands, or gcc warns
+    bool* labels = calloc(ROM_SIZE, sizeof(bool));
+    int links = 0;
+    int sites = 0;
+    for (int i = 0; i < cfg.count; i++) {
+        const CfgBlock* block = &cfg.blocks[i];
+        bool calls = block->flow == FLOW_CALL || block->flow == FLOW_RST;
+        if (block->flow != FLOW_HALT && linked(&cfg, block->target)) {
+            labels[block->target] = true;
+            links++;
+        }
+        if (block->flow != FLOW_HALT && !calls && linked(&cfg, block->next)) {
+            labels[block->next] = true;
+            links++;
+        }
+        bool pushes = calls || block->flow == FLOW_CALL_COND;
+        if (pushes && linked(&cfg, block->target) && linked(&cfg, block->next) && !returnIds[block->next]) {
+            returnIds[block->next] = ++returnCount;
+            returnSites[returnCount] = block->next;
+            labels[block->next] = true;
+        }
+        sites += block->flow == FLOW_PCHL && sites < AOT_PCHL_SITES;
+    }
+    // any linked block may be a PCHL target, so with a PCHL all of them are
+    // labelled, and listed by address for the cache to look them up
+    int targets = 0;
+    for (uint32_t address = 0; address < ROM_SIZE && sites; address++) {
+        if (linked(&cfg, address)) {
+            labels[address] = true;
+            targets++;
+        }
+    }
+
+    // the return address ring (AotCache): each linked call pushes the id of
+    // its return site, and RET pops one and goes straight there when the
+    // address it popped off the guest's stack is that site's. code that
+    // returns elsewhere, by moving the stack or pushing its own addresses,
+    // fails the check and costs that one entry. the ring is the caller's, as
+    // most calls are made in one run of the block loop and returned from in
+    // a later one, and the board pushes a 0 for each interrupt it takes,
+    // which its handler's RET pops
+    fprintf(out, "static const uint32_t returnSites[%d] = {\n    0x10000,", returnCount + 1);
+    for (int i = 1; i <= returnCount; i++) {
+        fprintf(out, "%s0x%04X,", i % 8 ? " " : "\n    ", returnSites[i]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "int aotRunBlock (i8080* state, AotCache* cache, uint64_t budget, uint16_t* from) {\n");
+    fprintf(out, "    uint16_t temp;\n    uint8_t m;\n");
+    fprintf(out, "    int last = FLOW_NONE;       // of the block before a trip round the switch\n");
+    if (sites) {
+        emitTargets(out, &cfg, targets);
+    }
+    fprintf(out, "    goto dispatch;\n");
+    fprintf(out, "predict:\n");
+    fprintf(out, "    if (cache->depth) {\n");
+    fprintf(out, "        uint16_t id = cache->returns[--cache->depth %% AOT_RETURNS];\n");
+    fprintf(out, "        if (state->pc == returnSites[id]) {\n");
+    fprintf(out, "            switch (id) {\n");
+    for (int i = 1; i <= returnCount; i++) {
+        fprintf(out, "            case %d: goto block_%04X;\n", i, returnSites[i]);
+    }
+    fprintf(out, "            }\n        }\n    }\n");
+    fprintf(out, "dispatch:\n");
+    fprintf(out, "    switch (state->pc) {\n");
+    for (int i = 0; i < cfg.count; i++) {
+        emitBlock(out, &cfg, &cfg.blocks[i], labels);
+    }
+    fprintf(out, "    default:\n        *from = state->pc;\n        return FLOW_NONE;\n    }\n}\n");
+    free(labels);
+    fclose(out);
+
+    fprintf(stderr, "recompile: %d blocks, %d instructions (%d with dead flags), %d linked edges, "
+                    "%d return sites, %d cached PCHLs from %d entry points\n",
+            cfg.count, instructions, trimmed, links, returnCount, sites, entryCount);
+    cfgFree(&cfg);
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include <string.h>
+#include "refcore.h"
+
+uint64_t refHashMemory (const uint8_t* memory) {
+    uint64_t hash = 0;
+    for (int a = 0; a < 65536; a++) {
+        hash += refHashByte(a, memory[a]);
+    }
+    return hash;
+}
+
+void refReset (RefCpu* cpu) {
+    memset(cpu->reg, 0, sizeof(cpu->reg));
+    cpu->f = 0x02;
+    cpu->sp = 0;
+    cpu->pc = 0;
+    cpu->ie = true;
+    cpu->halted = false;
+    cpu->cycles = 0;
+    cpu->hash = refHashMemory(cpu->memory);
+}
+
+static uint8_t load (RefCpu* cpu, uint16_t address) {
+    return cpu->memory[address];
+}
+
+static void store (RefCpu* cpu, uint16_t address, uint8_t value) {
+    cpu->hash += refHashByte(address, value) - refHashByte(address, cpu->memory[address]);
+    cpu->memory[address] = value;
+}
+
+static uint8_t fetch (RefCpu* cpu) {
+    return load(cpu, cpu->pc++);
+}
+
+static uint16_t fetchWord (RefCpu* cpu) {
+    uint8_t low = fetch(cpu);
+    return low | (fetch(cpu) << 8);
+}
+
+static uint8_t getReg (RefCpu* cpu, int r) {
+    return r == REF_M ? load(cpu, cpu->reg[REF_H] << 8 | cpu->reg[REF_L]) : cpu->reg[r];
+}
+
+static void setReg (RefCpu* cpu, int r, uint8_t value) {
+    if (r == REF_M) {
+        store(cpu, cpu->reg[REF_H] << 8 | cpu->reg[REF_L], value);
+    }
+    else {
+        cpu->reg[r] = value;
+    }
+}
+
+// register pairs by the 2-bit field: BC DE HL SP
+static uint16_t getPair (RefCpu* cpu, int rp) {
+    return rp == 3 ? cpu->sp : cpu->reg[rp * 2] << 8 | cpu->reg[rp * 2 + 1];
+}
+
+static void setPair (RefCpu* cpu, int rp, uint16_t value) {
+    if (rp == 3) {
+        cpu->sp = value;
+    }
+    else {
+        cpu->reg[rp * 2] = value >> 8;
+        cpu->reg[rp * 2 + 1] = value & 0xff;
+    }
+}
+
+static void push (RefCpu* cpu, uint16_t value) {
+    store(cpu, --cpu->sp, value >> 8);
+    store(cpu, --cpu->sp, value & 0xff);
+}
+
+static uint16_t pop (RefCpu* cpu) {
+    uint8_t low = load(cpu, cpu->sp++);
+    return low | (load(cpu, cpu->sp++) << 8);
+}
+
+static void setFlag (RefCpu* cpu, uint8_t flag, bool on) {
+    cpu->f = on ? cpu->f | flag : cpu->f & ~flag;
+}
+
+static void setSZP (RefCpu* cpu, uint8_t value) {
+    int ones = 0;
+    for (int i = 0; i < 8; i++) {
+        ones += (value >> i) & 1;
+    }
+    setFlag(cpu, REF_FLAG_S, value & 0x80);
+    setFlag(cpu, REF_FLAG_Z, value == 0);
+    setFlag(cpu, REF_FLAG_P, ones % 2 == 0);
+}
+
+// subtraction is addition of the complement with the carry inverted in and
+// out, which is also what the 8080 does to the auxiliary carry
+static uint8_t addBytes (RefCpu* cpu, uint8_t a, uint8_t b, int carry) {
+    int sum = a + b + carry;
+    setFlag(cpu, REF_FLAG_C, sum > 0xff);
+    setFlag(cpu, REF_FLAG_AC, (a & 0x0f) + (b & 0x0f) + carry > 0x0f);
+    setSZP(cpu, sum & 0xff);
+    return sum & 0xff;
+}
+
+static uint8_t subBytes (RefCpu* cpu, uint8_t a, uint8_t b, int borrow) {
+    uint8_t result = addBytes(cpu, a, ~b, !borrow);
+    cpu->f ^= REF_FLAG_C;
+    return result;
+}
+
+static void alu (RefCpu* cpu, int operation, uint8_t value) {
+    uint8_t a = cpu->reg[REF_A];
+    int carry = cpu->f & REF_FLAG_C;
+    switch (operation) {
+        case 0: cpu->reg[REF_A] = addBytes(cpu, a, value, 0); break;        // ADD
+        case 1: cpu->reg[REF_A] = addBytes(cpu, a, value, carry); break;    // ADC
+        case 2: cpu->reg[REF_A] = subBytes(cpu, a, value, 0); break;        // SUB
+        case 3: cpu->reg[REF_A] = subBytes(cpu, a, value, carry); break;    // SBB
+        case 4:                                                             // ANA
+            cpu->reg[REF_A] = a & value;
+            setSZP(cpu, a & value);
+            setFlag(cpu, REF_FLAG_C, false);
+            setFlag(cpu, REF_FLAG_AC, (a | value) & 0x08);
+            break;
+        case 5:                                                             // XRA
+        case 6:                                                             // ORA
+            cpu->reg[REF_A] = operation == 5 ? a ^ value : a | value;
+            setSZP(cpu, cpu->reg[REF_A]);
+            setFlag(cpu, REF_FLAG_C, false);
+            setFlag(cpu, REF_FLAG_AC, false);
+            break;
+        case 7: subBytes(cpu, a, value, 0); break;                          // CMP
+    }
+}
+
+static bool condition (RefCpu* cpu, int cc) {
+    static const uint8_t flags[4] = { REF_FLAG_Z, REF_FLAG_C, REF_FLAG_P, REF_FLAG_S };
+    bool set = (cpu->f & flags[cc >> 1]) != 0;
+    return (cc & 1) ? set : !set;
+}
+
+static void daa (RefCpu* cpu) {
+    uint8_t a = cpu->reg[REF_A];
+    uint8_t correction = 0;
+    bool carry = cpu->f & REF_FLAG_C;
+    if ((cpu->f & REF_FLAG_AC) || (a & 0x0f) > 9) {
+        correction |= 0x06;
+    }
+    if (carry || (a >> 4) > 9 || ((a >> 4) >= 9 && (a & 0x0f) > 9)) {
+        correction |= 0x60;
+        carry = true;
+    }
+    cpu->reg[REF_A] = addBytes(cpu, a, correction, 0);
+    setFlag(cpu, REF_FLAG_C, carry);
+}
+
+// rotates and the one-byte specials in the 00xxx111 column
+static void misc (RefCpu* cpu, int y) {
+    uint8_t a = cpu->reg[REF_A];
+    bool carry = cpu->f & REF_FLAG_C;
+    switch (y) {
+        case 0: cpu->reg[REF_A] = a << 1 | a >> 7; setFlag(cpu, REF_FLAG_C, a & 0x80); break;    // RLC
+        case 1: cpu->reg[REF_A] = a >> 1 | a << 7; setFlag(cpu, REF_FLAG_C, a & 0x01); break;    // RRC
+        case 2: cpu->reg[REF_A] = a << 1 | carry; setFlag(cpu, REF_FLAG_C, a & 0x80); break;     // RAL
+        case 3: cpu->reg[REF_A] = a >> 1 | carry << 7; setFlag(cpu, REF_FLAG_C, a & 0x01); break; // RAR
+        case 4: daa(cpu); break;
+        case 5: cpu->reg[REF_A] = ~a; break;                                                      // CMA
+        case 6: setFlag(cpu, REF_FLAG_C, true); break;                                            // STC
+        case 7: setFlag(cpu, REF_FLAG_C, !carry); break;                                          // CMC
+    }
+}
+
+void refStep (RefCpu* cpu) {
+    uint8_t op = fetch(cpu);
+    int x = op >> 6;
+    int y = (op >> 3) & 7;
+    int z = op & 7;
+    int rp = y >> 1;
+    uint16_t address, value;
+
+    if (x == 1) {
+        if (op == 0x76) {
+            cpu->halted = true;
+            cpu->cycles += 7;
+        }
+        else {
+            setReg(cpu, y, getReg(cpu, z));
+            cpu->cycles += (y == REF_M || z == REF_M) ? 7 : 5;
+        }
+        return;
+    }
+    if (x == 2) {
+        alu(cpu, y, getReg(cpu, z));
+        cpu->cycles += z == REF_M ? 7 : 4;
+        return;
+    }
+
+    if (x == 0) {
+        switch (z) {
+            case 0:                     // NOP and its undocumented copies
+                cpu->cycles += 4;
+                break;
+            case 1:
+                if (y & 1) {            // DAD
+                    uint32_t sum = getPair(cpu, 2) + getPair(cpu, rp);
+                    setPair(cpu, 2, sum & 0xffff);
+                    setFlag(cpu, REF_FLAG_C, sum > 0xffff);
+                }
+                else {                  // LXI
+                    setPair(cpu, rp, fetchWord(cpu));
+                }
+                cpu->cycles += 10;
+                break;
+            case 2:
+                switch (y) {
+                    case 0: case 2: store(cpu, getPair(cpu, rp), cpu->reg[REF_A]); cpu->cycles += 7; break;    // STAX
+                    case 1: case 3: cpu->reg[REF_A] = load(cpu, getPair(cpu, rp)); cpu->cycles += 7; break;     // LDAX
+                    case 4:             // SHLD
+                        address = fetchWord(cpu);
+                        store(cpu, address, cpu->reg[REF_L]);
+                        store(cpu, address + 1, cpu->reg[REF_H]);
+                        cpu->cycles += 16;
+                        break;
+                    case 5:             // LHLD
+                        address = fetchWord(cpu);
+                        cpu->reg[REF_L] = load(cpu, address);
+                        cpu->reg[REF_H] = load(cpu, address + 1);
+                        cpu->cycles += 16;
+                        break;
+                    case 6: store(cpu, fetchWord(cpu), cpu->reg[REF_A]); cpu->cycles += 13; break;            // STA
+                    case 7: cpu->reg[REF_A] = load(cpu, fetchWord(cpu)); cpu->cycles += 13; break;             // LDA
+                }
+                break;
+            case 3:                     // INX / DCX
+                setPair(cpu, rp, getPair(cpu, rp) + ((y & 1) ? -1 : 1));
+                cpu->cycles += 5;
+                break;
+            case 4:                     // INR
+            case 5: {                   // DCR
+                uint8_t result = getReg(cpu, y) + (z == 4 ? 1 : -1);
+                setReg(cpu, y, result);
+                setSZP(cpu, result);
+                setFlag(cpu, REF_FLAG_AC, z == 4 ? (result & 0x0f) == 0 : (result & 0x0f) != 0x0f);
+                cpu->cycles += y == REF_M ? 10 : 5;
+                break;
+            }
+            case 6:                     // MVI
+                setReg(cpu, y, fetch(cpu));
+                cpu->cycles += y == REF_M ? 10 : 7;
+                break;
+            case 7:
+                misc(cpu, y);
+                cpu->cycles += 4;
+                break;
+        }
+        return;
+    }
+
+    switch (z) {
+        case 0:                         // Rcc
+            cpu->cycles += 5;
+            if (condition(cpu, y)) {
+                cpu->pc = pop(cpu);
+                cpu->cycles += 6;
+            }
+            break;
+        case 1:
+            if (!(y & 1)) {             // POP, pair 3 is PSW here
+                value = pop(cpu);
+                if (rp == 3) {
+                    cpu->reg[REF_A] = value >> 8;
+                    cpu->f = (value & 0xd5) | 0x02;
+                }
+                else {
+                    setPair(cpu, rp, value);
+                }
+                cpu->cycles += 10;
+            }
+            else if (rp < 2) {          // RET and its copy
+                cpu->pc = pop(cpu);
+                cpu->cycles += 10;
+            }
+            else if (rp == 2) {         // PCHL
+                cpu->pc = getPair(cpu, 2);
+                cpu->cycles += 5;
+            }
+            else {                      // SPHL
+                cpu->sp = getPair(cpu, 2);
+                cpu->cycles += 5;
+            }
+            break;
+        case 2:                         // Jcc
+            address = fetchWord(cpu);
+            if (condition(cpu, y)) {
+                cpu->pc = address;
+            }
+            cpu->cycles += 10;
+            break;
+        case 3:
+            switch (y) {
+                case 0: case 1: cpu->pc = fetchWord(cpu); cpu->cycles += 10; break;                     // JMP
+                case 2:                 // OUT
+                    value = fetch(cpu);
+                    if (cpu->out) {
+                        cpu->out(cpu, value, cpu->reg[REF_A]);
+                    }
+                    cpu->cycles += 10;
+                    break;
+                case 3:                 // IN
+                    value = fetch(cpu);
+                    if (cpu->in) {
+                        cpu->reg[REF_A] = cpu->in(cpu, value);
+                    }
+                    cpu->cycles += 10;
+                    break;
+                case 4:                 // XTHL
+                    value = pop(cpu);
+                    push(cpu, getPair(cpu, 2));
+                    setPair(cpu, 2, value);
+                    cpu->cycles += 18;
+                    break;
+                case 5:                 // XCHG
+                    value = getPair(cpu, 1);
+                    setPair(cpu, 1, getPair(cpu, 2));
+                    setPair(cpu, 2, value);
+                    cpu->cycles += 5;
+                    break;
+                case 6: cpu->ie = false; cpu->cycles += 4; break;   // DI
+                case 7: cpu->ie = true; cpu->cycles += 4; break;    // EI
+            }
+            break;
+        case 4:                         // Ccc
+            address = fetchWord(cpu);
+            cpu->cycles += 11;
+            if (condition(cpu, y)) {
+                push(cpu, cpu->pc);
+                cpu->pc = address;
+                cpu->cycles += 6;
+            }
+            break;
+        case 5:
+            if (!(y & 1)) {             // PUSH
+                push(cpu, rp == 3 ? cpu->reg[REF_A] << 8 | ((cpu->f & 0xd5) | 0x02) : getPair(cpu, rp));
+                cpu->cycles += 11;
+            }
+            else {                      // CALL and its copies
+                address = fetchWord(cpu);
+                push(cpu, cpu->pc);
+                cpu->pc = address;
+                cpu->cycles += 17;
+            }
+            break;
+        case 6:                         // ALU immediate
+            alu(cpu, y, fetch(cpu));
+            cpu->cycles += 7;
+            break;
+        case 7:                         // RST
+            push(cpu, cpu->pc);
+            cpu->pc = y * 8;
+            cpu->cycles += 11;
+            break;
+    }
+}
+
+// RST number put on the bus by an interrupting device; ignored while
+// interrupts are disabled, and takes the cpu out of HLT
+void refInterrupt (RefCpu* cpu, int number) {
+    if (!cpu->ie) {
+        return;
+    }
+    cpu->ie = false;
+    cpu->halted = false;
+    push(cpu, cpu->pc);
+    cpu->pc = number * 8;
+    cpu->cycles += 11;
+}
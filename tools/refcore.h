@@ -0,0 +1,59 @@
+#ifndef REFCORE_H
+#define REFCORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// deliberately simple 8080 used as the oracle by tools/lockstep.c
+// written independently of i8080.c: instructions are decoded from their bit
+// fields instead of a 256-way switch, flags live in a PSW byte, and nothing
+// is tuned for speed. keep it that way; it is only useful while it stays obvious
+
+#define REF_B 0
+#define REF_C 1
+#define REF_D 2
+#define REF_E 3
+#define REF_H 4
+#define REF_L 5
+#define REF_M 6         // memory at HL, never stored in reg[]
+#define REF_A 7
+
+#define REF_FLAG_C 0x01
+#define REF_FLAG_P 0x04
+#define REF_FLAG_AC 0x10
+#define REF_FLAG_Z 0x40
+#define REF_FLAG_S 0x80
+
+typedef struct RefCpu RefCpu;
+
+struct RefCpu {
+    uint8_t reg[8];         // indexed by the 3-bit register field of the opcode
+    uint8_t f;              // S Z 0 AC 0 P 1 C
+    uint16_t sp;
+    uint16_t pc;
+    bool ie;
+    bool halted;
+    uint64_t cycles;
+
+    uint64_t hash;          // sum of refHashByte over memory, kept up to date by every store
+    uint8_t (*in) (RefCpu* cpu, uint8_t port);
+    void (*out) (RefCpu* cpu, uint8_t port, uint8_t value);
+    void* context;
+    uint8_t memory[65536];
+};
+
+// order-independent memory hash: the sum over all addresses, so one store
+// updates it by subtracting the old byte's term and adding the new one
+static inline uint64_t refHashByte (uint16_t address, uint8_t value) {
+    uint64_t x = ((uint64_t) address << 8 | value) + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint64_t refHashMemory (const uint8_t* memory);
+void refReset (RefCpu* cpu);
+void refStep (RefCpu* cpu);
+void refInterrupt (RefCpu* cpu, int number);
+
+#endif
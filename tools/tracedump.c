@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../opcodes.h"
+#include "../trace.h"
+
+// pretty prints traces written by the emulator built with -DI8080_TRACE
+// usage: tracedump <ring file> [last N records]
+//        tracedump <stream file> [first index] [count]
+
+static void flagString (uint8_t flags, char* out) {
+    out[0] = (flags & 0x80) ? 'S' : '-';
+    out[1] = (flags & 0x40) ? 'Z' : '-';
+    out[2] = (flags & 0x10) ? 'A' : '-';
+    out[3] = (flags & 0x04) ? 'P' : '-';
+    out[4] = (flags & 0x01) ? 'C' : '-';
+    out[5] = '\0';
+}
+
+static void printRecord (uint64_t index, const TraceRecord* record) {
+    char flags[6];
+    char text[32];
+    flagString(record->flags, flags);
+    formatInstruction(record->opcode, record->operand[0], record->operand[1], text, sizeof(text));
+    printf("%10llu  %04X  %02X  %-14s A=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X SP=%04X %s\n",
+           (unsigned long long) index, record->pc, record->opcode, text,
+           record->a, record->b, record->c, record->d, record->e, record->h, record->l, record->sp, flags);
+}
+
+static int dumpRing (FILE* file, int argc, char** argv) {
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1) {
+        fprintf(stderr, "Error: Truncated trace header\n");
+        return 1;
+    }
+    if (header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord)) {
+        fprintf(stderr, "Error: Unsupported trace version %u\n", header.version);
+        return 1;
+    }
+
+    uint32_t skip = 0;
+    if (argc > 2) {
+        uint32_t last = (uint32_t) strtoul(argv[2], NULL, 0);
+        skip = last < header.count ? header.count - last : 0;
+    }
+    fseek(file, (long) (skip * sizeof(TraceRecord)), SEEK_CUR);
+
+    // index of the first record in the file relative to the start of the run
+    uint64_t index = header.total - header.count + skip;
+    TraceRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        printRecord(index++, &record);
+    }
+    return 0;
+}
+
+// reads the chunk index from the trailer, or rebuilds it by hopping over
+// chunk headers when the run died before the trailer was written
+static TraceIndexEntry* readIndex (FILE* file, uint32_t* chunks) {
+    TraceStreamTrailer trailer;
+    TraceIndexEntry* index = NULL;
+    *chunks = 0;
+
+    if (fseek(file, -(long) sizeof(trailer), SEEK_END) == 0 &&
+        fread(&trailer, sizeof(trailer), 1, file) == 1 && trailer.magic == TRACE_INDEX_MAGIC) {
+        index = malloc((trailer.chunks + 1) * sizeof(TraceIndexEntry));
+        fseek(file, (long) trailer.indexOffset, SEEK_SET);
+        if (fread(index, sizeof(TraceIndexEntry), trailer.chunks, file) == trailer.chunks) {
+            *chunks = trailer.chunks;
+            return index;
+        }
+        free(index);
+        index = NULL;
+    }
+
+    uint32_t capacity = 0;
+    uint64_t offset = sizeof(TraceStreamHeader);
+    TraceChunkHeader chunk;
+    fseek(file, (long) offset, SEEK_SET);
+    while (fread(&chunk, sizeof(chunk), 1, file) == 1 && chunk.magic == TRACE_CHUNK_MAGIC) {
+        if (*chunks == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            index = realloc(index, capacity * sizeof(TraceIndexEntry));
+        }
+        index[*chunks].first = chunk.first;
+        index[*chunks].offset = offset;
+        (*chunks)++;
+        offset += sizeof(chunk) + chunk.bytes;
+        fseek(file, (long) offset, SEEK_SET);
+    }
+    return index;
+}
+
+static const uint8_t* decodeRecord (const uint8_t* in, TraceRecord* record) {
+    uint8_t tag = *in++;
+    if ((tag & TRACE_PC_MASK) == TRACE_PC_ABSOLUTE) {
+        record->pc = in[0] | (in[1] << 8);
+        in += 2;
+    }
+    else {
+        record->pc += (tag & TRACE_PC_MASK) + 1;
+    }
+    record->opcode = *in++;
+    for (int i = 1; i < opcodeTable[record->opcode].length; i++) {
+        record->operand[i - 1] = *in++;
+    }
+    if (tag & TRACE_TAG_FLAGS) {
+        record->flags = *in++;
+    }
+    if (tag & TRACE_TAG_SP) {
+        record->sp = in[0] | (in[1] << 8);
+        in += 2;
+    }
+    if (tag & TRACE_TAG_REGS) {
+        uint8_t mask = *in++;
+        if (mask & 0x01) record->a = *in++;
+        if (mask & 0x02) record->b = *in++;
+        if (mask & 0x04) record->c = *in++;
+        if (mask & 0x08) record->d = *in++;
+        if (mask & 0x10) record->e = *in++;
+        if (mask & 0x20) record->h = *in++;
+        if (mask & 0x40) record->l = *in++;
+    }
+    return in;
+}
+
+static int dumpStream (FILE* file, int argc, char** argv) {
+    TraceStreamHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.version != TRACE_STREAM_VERSION) {
+        fprintf(stderr, "Error: Unsupported trace stream\n");
+        return 1;
+    }
+    uint64_t first = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+    uint64_t count = argc > 3 ? strtoull(argv[3], NULL, 0) : 100;
+
+    uint32_t chunks;
+    TraceIndexEntry* index = readIndex(file, &chunks);
+    if (!chunks) {
+        fprintf(stderr, "Error: Trace stream has no chunks\n");
+        free(index);
+        return 1;
+    }
+
+    // last chunk starting at or before the requested instruction
+    uint32_t lo = 0, hi = chunks;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (index[mid].first <= first) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    uint8_t* payload = malloc(header.chunkRecords * TRACE_MAX_ENCODED);
+    for (uint32_t i = lo; i < chunks && count; i++) {
+        TraceChunkHeader chunk;
+        fseek(file, (long) index[i].offset, SEEK_SET);
+        if (fread(&chunk, sizeof(chunk), 1, file) != 1 || chunk.magic != TRACE_CHUNK_MAGIC ||
+            fread(payload, 1, chunk.bytes, file) != chunk.bytes) {
+            fprintf(stderr, "Error: Corrupt chunk at offset %llu\n", (unsigned long long) index[i].offset);
+            break;
+        }
+
+        TraceRecord record = chunk.keyframe;
+        const uint8_t* in = payload;
+        for (uint32_t n = 0; n < chunk.count && count; n++) {
+            in = decodeRecord(in, &record);
+            if (chunk.first + n >= first) {
+                printRecord(chunk.first + n, &record);
+                count--;
+            }
+        }
+    }
+
+    free(payload);
+    free(index);
+    return 0;
+}
+
+int main (int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <ring file> [last N]\n"
+                        "       %s <stream file> [first index] [count]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t magic = 0;
+    int result = 1;
+    if (fread(&magic, sizeof(magic), 1, file) == 1) {
+        rewind(file);
+        if (magic == TRACE_MAGIC) {
+            result = dumpRing(file, argc, argv);
+        }
+        else if (magic == TRACE_STREAM_MAGIC) {
+            result = dumpStream(file, argc, argv);
+        }
+    }
+    if (magic != TRACE_MAGIC && magic != TRACE_STREAM_MAGIC) {
+        fprintf(stderr, "Error: %s is not a trace file\n", argv[1]);
+    }
+
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "trace.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+TraceRing traceRing;
+bool traceEnabled = false;
+volatile int traceDumpRequested = 0;
+
+static const char* tracePath = "i8080.trace";
+
+// only async-signal-safe calls in here, it also runs from the crash handler
+int traceDump (void) {
+    int fd = open(tracePath, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    uint64_t head = traceRing.head;
+    uint32_t count = head < TRACE_RING_SIZE ? (uint32_t) head : TRACE_RING_SIZE;
+    uint32_t first = (uint32_t) ((head - count) & TRACE_RING_MASK);
+
+    TraceHeader header = {0};
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    header.total = head;
+    header.count = count;
+
+    int ok = write(fd, &header, sizeof(header)) == sizeof(header);
+    // oldest records sit after the write position once the ring has wrapped
+    uint32_t tail = (first + count > TRACE_RING_SIZE) ? TRACE_RING_SIZE - first : count;
+    ok = ok && write(fd, &traceRing.records[first], tail * sizeof(TraceRecord)) == (ssize_t) (tail * sizeof(TraceRecord));
+    if (count > tail) {
+        ok = ok && write(fd, &traceRing.records[0], (count - tail) * sizeof(TraceRecord)) == (ssize_t) ((count - tail) * sizeof(TraceRecord));
+    }
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static void traceCrash (int sig) {
+    traceDump();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+#ifdef SIGUSR1
+static void traceRequest (int sig) {
+    (void) sig;
+    traceDumpRequested = 1;
+}
+#endif
+
+void traceInit (const char* path) {
+    if (path) {
+        tracePath = path;
+    }
+    traceRing.head = 0;
+    traceEnabled = true;
+
+    signal(SIGSEGV, traceCrash);
+    signal(SIGABRT, traceCrash);
+    signal(SIGFPE, traceCrash);
+    signal(SIGILL, traceCrash);
+#ifdef SIGUSR1
+    signal(SIGUSR1, traceRequest);  // kill -USR1 <pid> dumps at the next instruction
+#endif
+}
+
+// streaming writer: the run loop encodes into one chunk buffer while the
+// writer thread flushes the other, so the emulation thread never blocks on
+// disk unless the writer falls a whole chunk behind
+
+TraceStream traceStream;
+bool traceStreaming = false;
+
+#define TRACE_CHUNK_BYTES (TRACE_CHUNK_RECORDS * TRACE_MAX_ENCODED)
+
+static FILE* streamFile;
+static uint8_t* streamBuffers[2];
+static int streamCurrent;
+static TraceChunkHeader streamChunk;        // header of the chunk being filled
+
+static pthread_t streamThread;
+static pthread_mutex_t streamLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t streamCond = PTHREAD_COND_INITIALIZER;
+static TraceChunkHeader streamPendingHeader;
+static uint8_t* streamPending;              // chunk handed to the writer, NULL when idle
+static bool streamQuit;
+
+static TraceIndexEntry* streamIndex;
+static uint32_t streamChunks;
+static uint32_t streamIndexCapacity;
+static bool streamError;
+static uint64_t streamOffset;               // tracked by hand, ftell is 32-bit on some targets
+
+static void streamWrite (const TraceChunkHeader* header, const uint8_t* payload) {
+    if (streamChunks == streamIndexCapacity) {
+        streamIndexCapacity = streamIndexCapacity ? streamIndexCapacity * 2 : 1024;
+        streamIndex = realloc(streamIndex, streamIndexCapacity * sizeof(TraceIndexEntry));
+    }
+    streamIndex[streamChunks].first = header->first;
+    streamIndex[streamChunks].offset = streamOffset;
+    streamChunks++;
+    streamOffset += sizeof(*header) + header->bytes;
+
+    if (fwrite(header, sizeof(*header), 1, streamFile) != 1 ||
+        fwrite(payload, 1, header->bytes, streamFile) != header->bytes) {
+        streamError = true;
+    }
+}
+
+static void* streamWriter (void* arg) {
+    (void) arg;
+    pthread_mutex_lock(&streamLock);
+    for (;;) {
+        while (!streamPending && !streamQuit) {
+            pthread_cond_wait(&streamCond, &streamLock);
+        }
+        if (!streamPending) {
+            break;
+        }
+        pthread_mutex_unlock(&streamLock);
+        streamWrite(&streamPendingHeader, streamPending);
+        pthread_mutex_lock(&streamLock);
+        streamPending = NULL;
+        pthread_cond_broadcast(&streamCond);
+    }
+    pthread_mutex_unlock(&streamLock);
+    return NULL;
+}
+
+static void streamStartChunk (void) {
+    traceStream.out = streamBuffers[streamCurrent];
+    traceStream.count = 0;
+    streamChunk.first += streamChunk.count;
+    streamChunk.keyframe = traceStream.prev;
+}
+
+// undoes traceStreamOpen when it fails part way
+static void streamAbandon (void) {
+    free(streamBuffers[0]);
+    free(streamBuffers[1]);
+    streamBuffers[0] = streamBuffers[1] = NULL;
+    fclose(streamFile);
+    streamFile = NULL;
+}
+
+int traceStreamOpen (const char* path) {
+    streamFile = fopen(path, "wb");
+    if (!streamFile) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+    streamBuffers[0] = malloc(TRACE_CHUNK_BYTES);
+    streamBuffers[1] = malloc(TRACE_CHUNK_BYTES);
+    if (!streamBuffers[0] || !streamBuffers[1]) {
+        fprintf(stderr, "Error: Could not allocate trace buffers\n");
+        streamAbandon();
+        return -1;
+    }
+
+    TraceStreamHeader header = {0};
+    header.magic = TRACE_STREAM_MAGIC;
+    header.version = TRACE_STREAM_VERSION;
+    header.chunkRecords = TRACE_CHUNK_RECORDS;
+    fwrite(&header, sizeof(header), 1, streamFile);
+    streamOffset = sizeof(header);
+
+    streamChunk.magic = TRACE_CHUNK_MAGIC;
+    streamChunk.first = 0;
+    streamChunk.count = 0;
+    streamCurrent = 0;
+    traceStream.prev = (TraceRecord) {0};
+    streamStartChunk();
+
+    streamQuit = false;
+    if (pthread_create(&streamThread, NULL, streamWriter, NULL) != 0) {
+        fprintf(stderr, "Error: Could not start trace writer\n");
+        streamAbandon();
+        return -1;
+    }
+    traceStreaming = true;
+    return 0;
+}
+
+// called by traceStreamRecord when the current chunk is full
+void traceStreamChunk (void) {
+    streamChunk.count = traceStream.count;
+    streamChunk.bytes = (uint32_t) (traceStream.out - streamBuffers[streamCurrent]);
+
+    pthread_mutex_lock(&streamLock);
+    while (streamPending) {
+        pthread_cond_wait(&streamCond, &streamLock);
+    }
+    streamPendingHeader = streamChunk;
+    streamPending = streamBuffers[streamCurrent];
+    pthread_cond_broadcast(&streamCond);
+    pthread_mutex_unlock(&streamLock);
+
+    streamCurrent ^= 1;
+    streamStartChunk();
+}
+
+void traceStreamClose (void) {
+    if (!traceStreaming) {
+        return;
+    }
+    traceStreaming = false;
+    if (traceStream.count) {
+        traceStreamChunk();
+    }
+
+    pthread_mutex_lock(&streamLock);
+    streamQuit = true;
+    pthread_cond_broadcast(&streamCond);
+    pthread_mutex_unlock(&streamLock);
+    pthread_join(streamThread, NULL);
+
+    TraceStreamTrailer trailer;
+    trailer.indexOffset = streamOffset;
+    trailer.chunks = streamChunks;
+    trailer.magic = TRACE_INDEX_MAGIC;
+    fwrite(streamIndex, sizeof(TraceIndexEntry), streamChunks, streamFile);
+    fwrite(&trailer, sizeof(trailer), 1, streamFile);
+    if (fclose(streamFile) != 0 || streamError) {
+        fprintf(stderr, "Error: Trace stream was not written completely\n");
+    }
+
+    free(streamBuffers[0]);
+    free(streamBuffers[1]);
+    streamBuffers[0] = streamBuffers[1] = NULL;
+    streamFile = NULL;
+    free(streamIndex);
+    streamIndex = NULL;
+    streamChunks = streamIndexCapacity = 0;
+}
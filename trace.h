@@ -0,0 +1,185 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "opcodes.h"
+
+// per-instruction trace, compiled in with -DI8080_TRACE
+// records are raw binary; formatting is done offline by tools/tracedump.c
+// two modes: a fixed ring of the last records (--trace) and a full
+// delta-encoded stream written by a background thread (--trace-stream)
+
+#define TRACE_MAGIC 0x54303849u    // "I80T" little endian
+#define TRACE_VERSION 1
+
+#ifndef TRACE_RING_BITS
+#define TRACE_RING_BITS 16         // 65536 records, 1 MiB
+#endif
+#define TRACE_RING_SIZE (1u << TRACE_RING_BITS)
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+typedef struct {
+    uint16_t pc;
+    uint16_t sp;
+    uint8_t opcode;
+    uint8_t operand[2];
+    uint8_t flags;      // 8080 PSW layout (S Z 0 AC 0 P 1 C)
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    uint8_t d;
+    uint8_t e;
+    uint8_t h;
+    uint8_t l;
+    uint8_t pad;
+} TraceRecord;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t total;     // instructions recorded since start
+    uint32_t count;     // records that follow, oldest first
+    uint32_t pad;
+} TraceHeader;
+
+typedef struct {
+    uint64_t head;      // next slot, never wraps; slot = head & TRACE_RING_MASK
+    TraceRecord records[TRACE_RING_SIZE];
+} TraceRing;
+
+extern TraceRing traceRing;
+extern bool traceEnabled;
+extern volatile int traceDumpRequested;
+
+void traceInit (const char* path);
+int traceDump (void);
+
+static inline TraceRecord* traceNext (void) {
+    return &traceRing.records[traceRing.head++ & TRACE_RING_MASK];
+}
+
+// stream file: TraceStreamHeader, chunks (TraceChunkHeader + payload), index, TraceStreamTrailer
+// every chunk carries a keyframe so a reader can start decoding at any chunk;
+// the index at the end maps chunk -> first instruction, and if it is missing
+// (crash) the chunk headers can be walked without decoding payloads
+#define TRACE_STREAM_MAGIC 0x53303849u  // "I80S"
+#define TRACE_CHUNK_MAGIC 0x4b4e4843u   // "CHNK"
+#define TRACE_INDEX_MAGIC 0x58444e49u   // "INDX"
+#define TRACE_STREAM_VERSION 2
+
+#ifndef TRACE_CHUNK_BITS
+#define TRACE_CHUNK_BITS 16
+#endif
+#define TRACE_CHUNK_RECORDS (1u << TRACE_CHUNK_BITS)
+#define TRACE_MAX_ENCODED 20        // worst case bytes per encoded record
+
+// record tag byte, followed by the fields it announces in this order. the
+// opcode is always there, with the operand bytes its instruction has
+// (opcodeTable length), so a record decodes without a memory image
+#define TRACE_PC_MASK 0x03          // 0..2: pc advanced by 1..3, 3: absolute pc follows
+#define TRACE_PC_ABSOLUTE 0x03
+#define TRACE_TAG_FLAGS 0x04
+#define TRACE_TAG_SP 0x08
+#define TRACE_TAG_REGS 0x10         // register mask byte follows: A B C D E H L in bits 0..6
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t pad;
+    uint32_t chunkRecords;
+    uint32_t pad2;
+} TraceStreamHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t bytes;         // encoded payload that follows
+    uint64_t first;         // index of the first record in the chunk
+    uint32_t count;
+    uint32_t pad;
+    TraceRecord keyframe;   // state the first record is encoded against
+} TraceChunkHeader;
+
+typedef struct {
+    uint64_t first;
+    uint64_t offset;        // file offset of the chunk header
+} TraceIndexEntry;
+
+typedef struct {
+    uint64_t indexOffset;
+    uint32_t chunks;
+    uint32_t magic;
+} TraceStreamTrailer;
+
+typedef struct {
+    uint8_t* out;           // write position in the chunk being filled
+    uint32_t count;         // records in the current chunk
+    TraceRecord prev;
+} TraceStream;
+
+extern TraceStream traceStream;
+extern bool traceStreaming;
+
+int traceStreamOpen (const char* path);
+void traceStreamChunk (void);
+void traceStreamClose (void);
+
+#define TRACE_STREAM_REG(field, bit) \
+    if (record->field != prev->field) { mask |= (bit); *out++ = record->field; }
+
+static inline void traceStreamRecord (const TraceRecord* record) {
+    TraceRecord* prev = &traceStream.prev;
+    uint8_t* out = traceStream.out;
+    uint8_t* tag = out++;
+    uint8_t t;
+
+    uint16_t delta = (uint16_t) (record->pc - prev->pc);
+    if (delta >= 1 && delta <= 3) {
+        t = delta - 1;
+    }
+    else {
+        t = TRACE_PC_ABSOLUTE;
+        *out++ = record->pc & 0xff;
+        *out++ = record->pc >> 8;
+    }
+    *out++ = record->opcode;
+    for (int i = 1; i < opcodeTable[record->opcode].length; i++) {
+        *out++ = record->operand[i - 1];
+    }
+    if (record->flags != prev->flags) {
+        t |= TRACE_TAG_FLAGS;
+        *out++ = record->flags;
+    }
+    if (record->sp != prev->sp) {
+        t |= TRACE_TAG_SP;
+        *out++ = record->sp & 0xff;
+        *out++ = record->sp >> 8;
+    }
+
+    uint8_t* maskOut = out++;
+    uint8_t mask = 0;
+    TRACE_STREAM_REG(a, 0x01);
+    TRACE_STREAM_REG(b, 0x02);
+    TRACE_STREAM_REG(c, 0x04);
+    TRACE_STREAM_REG(d, 0x08);
+    TRACE_STREAM_REG(e, 0x10);
+    TRACE_STREAM_REG(h, 0x20);
+    TRACE_STREAM_REG(l, 0x40);
+    if (mask) {
+        t |= TRACE_TAG_REGS;
+        *maskOut = mask;
+    }
+    else {
+        out = maskOut;
+    }
+
+    *tag = t;
+    *prev = *record;
+    traceStream.out = out;
+    if (++traceStream.count == TRACE_CHUNK_RECORDS) {
+        traceStreamChunk();
+    }
+}
+
+#endif